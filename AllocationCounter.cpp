@@ -0,0 +1,28 @@
+#include "AllocationCounter.hpp"
+using namespace cv;
+
+std::atomic<long long> AllocationCounter::count {0};
+
+void AllocationCounter::Install () {
+    static AllocationCounter counter;
+    Mat::setDefaultAllocator(&counter);
+}
+
+long long AllocationCounter::Count () {
+    return count.load(std::memory_order_relaxed);
+}
+
+UMatData* AllocationCounter::allocate (int dims, const int* sizes, int type, void* data, size_t* step,
+                                       AccessFlag flags, UMatUsageFlags usageFlags) const {
+    // Headers wrapping user memory don't allocate anything
+    if (!data) {count.fetch_add(1, std::memory_order_relaxed);}
+    return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+}
+
+bool AllocationCounter::allocate (UMatData* data, AccessFlag accessFlags, UMatUsageFlags usageFlags) const {
+    return Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+}
+
+void AllocationCounter::deallocate (UMatData* data) const {
+    Mat::getStdAllocator()->deallocate(data);
+}
@@ -0,0 +1,24 @@
+#ifndef ALLOCATIONCOUNTER_HPP
+#define ALLOCATIONCOUNTER_HPP
+
+#include <opencv2/core.hpp>
+#include <atomic>
+
+// Mat allocator that counts every pixel buffer OpenCV allocates.
+// Install() makes it the default allocator; memory itself still comes
+// from OpenCV's standard allocator.
+class AllocationCounter : public cv::MatAllocator {
+    private:
+        static std::atomic<long long> count;
+
+    public:
+        static void Install();
+        static long long Count();
+
+        cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                               cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override;
+        bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override;
+        void deallocate(cv::UMatData* data) const override;
+};
+
+#endif
@@ -0,0 +1,435 @@
+#include "AsyncRecorder.hpp"
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+using namespace cv;
+
+// One recording: its file, the encoded frames waiting for their turn and
+// the thread writing them
+struct AsyncRecorder::Session {
+    // JPEG data, or the frame itself in raw files
+    struct Frame {
+        std::vector<uchar> jpeg;
+        Mat raw;
+        int64_t timestampNs = 0;
+        FrameTracer::Context trace;     // Frame the write span belongs to
+
+        size_t Bytes () const {return raw.empty() ? jpeg.size() : raw.total()*raw.elemSize();}
+    };
+
+    long long id = 0;
+    std::string path;
+    Size size;
+    double fps = 0;
+    int type = CV_8UC3;
+    AviWriter writer;
+    RawVideoWriter rawWriter;
+    std::thread muxer;
+
+    std::mutex mutex;
+    std::condition_variable frameReady,
+                            slotFree;
+    std::map<long long, Frame> encoded;     // Out of order encoder output
+    long long nextSequence = 0,
+              nextWrite = 0;
+    size_t inFlight = 0;
+    bool stopping = false;
+
+    // Pre-record: frames before liveFrom were buffered before there was a
+    // file, and don't count in inFlight once encoded
+    std::atomic<bool> buffering {false};
+    long long liveFrom = LLONG_MAX;
+    size_t bufferedFrames = 0,
+           bufferedBytes = 0;
+    int64_t newestNs = 0,           // Latest frame submitted
+            firstWrittenNs = -1;    // Raw timestamps start from the first frame in the file
+
+    bool writeFailed = false;       // Only the muxer reads and writes it
+    std::atomic<bool> done {false};
+    std::atomic<long long> bytes {0};
+    std::chrono::steady_clock::time_point start,
+                                          end,
+                                          firstFrame;   // Time given with sequence 0
+};
+
+// Files after the first AVI_MAX_BYTES become name_2.avi, name_3.avi...
+static std::string SegmentPath (const std::string &path, int segment) {
+    if (segment == 0) {return path;}
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {dot = path.size();}
+    return path.substr(0, dot) + "_" + std::to_string(segment + 1) + path.substr(dot);
+}
+
+// Written under a temporary name, so a recording restarted while the previous
+// one is still flushing never shares its file
+static std::string PartPath (const std::string &path, int segment, long long id) {
+    return SegmentPath(path, segment) + "." + std::to_string(id) + ".part";
+}
+
+AsyncRecorder::AsyncRecorder (RecorderConfig config)
+    : config(config),
+      encoders(config.encoderThreads) {
+}
+
+AsyncRecorder::~AsyncRecorder () {
+    Stop();
+    WaitForFlush();
+    encoders.Wait();    // Frames still being encoded for a dropped history
+}
+
+void AsyncRecorder::SetProfiler (StageProfiler *profiler) {
+    this->profiler = profiler;
+}
+
+
+// Recording control
+bool AsyncRecorder::Start (const std::string &path, Size size, double fps, int type) {
+    // The pre-record history becomes the beginning of the file
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        if (current && current->buffering && current->size == size) {session = current;}
+    }
+    if (!session) {
+        Stop();
+        session = std::make_shared<Session>();
+        session->size = size;
+    }
+    ReapFinished();
+
+    session->id = ++lastSessionId;
+    session->path = path;
+    session->fps = fps;
+    session->type = type;
+    if (!OpenSegment(session.get(), 0)) {return false;}
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        session->liveFrom = session->nextSequence;
+        session->buffering = false;
+        submitted += session->liveFrom - session->nextWrite;    // The history still to write
+    }
+    session->start = std::chrono::steady_clock::now();
+    session->muxer = std::thread(&AsyncRecorder::MuxLoop, this, session.get());
+
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    current = session;
+    return true;
+}
+
+bool AsyncRecorder::IsRecording () {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    return current != nullptr && !current->buffering;
+}
+
+bool AsyncRecorder::Submit (const Mat &frame, std::chrono::steady_clock::time_point time) {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        session = current;
+    }
+    if (!session || session->buffering) {return false;}
+    return Enqueue(session, frame, time);
+}
+
+bool AsyncRecorder::Buffer (const Mat &frame, std::chrono::steady_clock::time_point time) {
+    if (config.preRecordSeconds <= 0) {return false;}
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        if (current && !current->buffering) {return false;}
+        if (current && current->size != frame.size()) {current.reset();}  // Start over at a new size
+        if (!current) {
+            current = std::make_shared<Session>();
+            current->size = frame.size();
+            current->type = frame.type();
+            current->buffering = true;
+        }
+        session = current;
+    }
+    return Enqueue(session, frame, time);
+}
+
+bool AsyncRecorder::Enqueue (std::shared_ptr<Session> session, const Mat &frame,
+                             std::chrono::steady_clock::time_point time) {
+    // Back-pressure: bound the frames held by encoders and the muxer
+    long long sequence;
+    int64_t timestampNs;
+    {
+        std::unique_lock<std::mutex> lock(session->mutex);
+        if (session->inFlight >= config.maxInFlight) {
+            // History is best effort: never hold up processing for it
+            if (session->buffering) {return false;}
+            if (config.dropWhenFull) {
+                dropped++;
+                return false;
+            }
+            session->slotFree.wait(lock, [this, &session]() {return session->inFlight < config.maxInFlight;});
+        }
+        sequence = session->nextSequence++;
+        session->inFlight++;
+        if (sequence == 0) {session->firstFrame = time;}
+        session->newestNs = std::chrono::duration_cast<std::chrono::nanoseconds>(time - session->firstFrame).count();
+        timestampNs = session->newestNs;
+    }
+    if (!session->buffering) {submitted++;}
+
+    // Nothing to encode: straight to the muxer
+    if (config.format == RecordFormat::Raw) {
+        Deliver(session.get(), sequence, frame, std::vector<uchar>(), timestampNs);
+        return true;
+    }
+
+    // The task holds a reference to the frame, not a copy
+    FrameTracer::Context trace = FrameTracer::CurrentContext();
+    encoders.Submit([this, session, sequence, frame, timestampNs, trace]() {
+        FrameTracer::SetContext(trace);
+        Encode(session, sequence, frame, timestampNs);
+    });
+    return true;
+}
+
+void AsyncRecorder::Stop () {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    if (!current) {return;}
+    if (current->buffering) {
+        // No file yet: the history is simply dropped
+        current.reset();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> sessionLock(current->mutex);
+        current->stopping = true;
+    }
+    current->frameReady.notify_all();
+    finishing.push_back(std::move(current));
+    current.reset();
+}
+
+void AsyncRecorder::WaitForFlush () {
+    std::vector<std::shared_ptr<Session>> sessions;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        sessions.swap(finishing);
+    }
+    for (std::shared_ptr<Session> &session : sessions) {
+        if (session->muxer.joinable()) {session->muxer.join();}
+    }
+}
+
+void AsyncRecorder::ReapFinished () {
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    for (size_t i = 0; i < finishing.size();) {
+        Session *session = finishing[i].get();
+        if (!session->done) {
+            i++;
+            continue;
+        }
+        if (session->muxer.joinable()) {session->muxer.join();}
+        std::chrono::duration<double> elapsed = session->end - session->start;
+        if (elapsed.count() > 0) {lastBytesPerSecond = session->bytes / elapsed.count();}
+        finishing.erase(finishing.begin() + i);
+    }
+}
+
+
+// Worker side
+void AsyncRecorder::Encode (std::shared_ptr<Session> session, long long sequence, Mat frame, int64_t timestampNs) {
+    std::vector<uchar> jpeg;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        StageTimer timer(profiler, Stage::Record);
+        if (frame.channels() == 1 && !config.greyscaleJpeg) {
+            // The frame stayed single-channel until here
+            Mat bgr;
+            cvtColor(frame, bgr, COLOR_GRAY2BGR);
+            frame = bgr;
+        }
+        std::vector<int> params = {IMWRITE_JPEG_QUALITY, config.jpegQuality};
+        if (!imencode(".jpg", frame, jpeg, params)) {jpeg.clear();}
+    }
+    frame.release();    // The buffer can go back to its pool
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    encodeMicroseconds += (long long)elapsed.count();
+    encodeCount++;
+
+    Deliver(session.get(), sequence, Mat(), std::move(jpeg), timestampNs);
+}
+
+// A frame ready to be written: to the muxer, or into the pre-record history
+void AsyncRecorder::Deliver (Session *session, long long sequence, Mat raw, std::vector<uchar> jpeg, int64_t timestampNs) {
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        bool keep = true;
+        if (sequence < session->liveFrom) {
+            // History: only bounded by the pre-record caps from now on
+            session->inFlight--;
+            keep = sequence >= session->nextWrite;  // Unless it is already older than what was trimmed
+        }
+        if (keep) {
+            Session::Frame &queued = session->encoded[sequence];
+            queued.raw = raw;
+            queued.jpeg = std::move(jpeg);
+            queued.timestampNs = timestampNs;
+            queued.trace = FrameTracer::CurrentContext();
+            if (sequence < session->liveFrom) {
+                session->bufferedFrames++;
+                session->bufferedBytes += queued.Bytes();
+            }
+            if (session->buffering) {TrimBuffer(session);}
+        }
+    }
+    session->frameReady.notify_one();
+    session->slotFree.notify_all();
+}
+
+// Drop the oldest history past the time or memory cap (session mutex held)
+void AsyncRecorder::TrimBuffer (Session *session) {
+    while (!session->encoded.empty()) {
+        std::map<long long, Session::Frame>::iterator oldest = session->encoded.begin();
+        bool tooOld = session->newestNs - oldest->second.timestampNs > config.preRecordSeconds*1e9;
+        if (!tooOld && session->bufferedBytes <= config.preRecordBytes) break;
+        session->bufferedFrames--;
+        session->bufferedBytes -= oldest->second.Bytes();
+        session->nextWrite = oldest->first + 1;
+        session->encoded.erase(oldest);
+    }
+}
+
+void AsyncRecorder::MuxLoop (Session *session) {
+    FrameTracer::NameThread("muxer");
+    int segment = 0;
+    for (;;) {
+        // Frames are written in submission order, whichever encoder finished first
+        Session::Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(session->mutex);
+            session->frameReady.wait(lock, [session]() {
+                return session->encoded.count(session->nextWrite) > 0 || (session->stopping && session->inFlight == 0);
+            });
+            std::map<long long, Session::Frame>::iterator it = session->encoded.find(session->nextWrite);
+            if (it == session->encoded.end()) break;
+            frame = std::move(it->second);
+            session->encoded.erase(it);
+        }
+        size_t frameBytes = frame.Bytes();
+
+        FrameTracer::SetContext(frame.trace);
+        if (session->writeFailed) {
+            failed++;
+        } else {
+            TraceScope trace(profiler ? profiler->Tracer() : nullptr, "Write");
+            if (config.format == RecordFormat::Raw) {
+                long long before = session->rawWriter.BytesWritten();
+                if (session->firstWrittenNs < 0) {session->firstWrittenNs = frame.timestampNs;}
+                if (session->rawWriter.WriteFrame(frame.raw, frame.timestampNs - session->firstWrittenNs)) {
+                    written++;
+                    session->bytes += session->rawWriter.BytesWritten() - before;
+                } else {
+                    failed++;
+                    session->writeFailed = true;
+                }
+                frame.raw.release();    // The buffer can go back to its pool
+            } else if (frame.jpeg.empty()) {
+                failed++;
+            } else {
+                // Stay under the AVI 1.0 size limit
+                if (session->writer.BytesWritten() + (long long)frame.jpeg.size() + 64 > AVI_MAX_BYTES) {
+                    FinishSegment(session, segment++);
+                    if (!OpenSegment(session, segment)) {session->writeFailed = true;}
+                }
+                if (!session->writeFailed && session->writer.WriteFrame(frame.jpeg.data(), frame.jpeg.size())) {
+                    written++;
+                    session->bytes += (long long)frame.jpeg.size();
+                } else {
+                    failed++;
+                    session->writeFailed = true;
+                }
+            }
+        }
+
+        if (session->writeFailed) {writeFailed = true;}
+
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            if (session->nextWrite < session->liveFrom) {
+                session->bufferedFrames--;
+                session->bufferedBytes -= frameBytes;
+            } else {
+                session->inFlight--;
+            }
+            session->nextWrite++;
+        }
+        session->slotFree.notify_all();
+    }
+
+    FinishSegment(session, segment);
+    session->end = std::chrono::steady_clock::now();
+    session->done = true;
+}
+
+bool AsyncRecorder::OpenSegment (Session *session, int segment) {
+    std::string part = PartPath(session->path, segment, session->id);
+    bool opened = config.format == RecordFormat::Raw
+                ? session->rawWriter.Open(part, session->size.width, session->size.height, session->type, session->fps)
+                : session->writer.Open(part, session->size.width, session->size.height, session->fps);
+    if (!opened) {std::remove(part.c_str());}     // No frame in it yet
+    return opened;
+}
+
+void AsyncRecorder::FinishSegment (Session *session, int segment) {
+    if (session->rawWriter.IsOpened()) {
+        session->rawWriter.Close();
+    } else if (session->writer.IsOpened()) {
+        session->writer.Close();
+    } else {
+        return;
+    }
+
+    // A newer recording replaces this one, as reopening the file used to
+    std::string part = PartPath(session->path, segment, session->id);
+    if (session->id == lastSessionId) {
+        std::remove(SegmentPath(session->path, segment).c_str());
+        std::rename(part.c_str(), SegmentPath(session->path, segment).c_str());
+    } else {
+        std::remove(part.c_str());
+    }
+}
+
+
+bool AsyncRecorder::HasWriteFailed () {
+    return writeFailed;
+}
+
+RecorderStats AsyncRecorder::GetStats () {
+    ReapFinished();
+    RecorderStats stats;
+    stats.submitted = submitted;
+    stats.written = written;
+    stats.dropped = dropped;
+    stats.failed = failed;
+    long long encodes = encodeCount;
+    stats.encodeMs = encodes > 0 ? encodeMicroseconds / 1000.0 / encodes : 0;
+
+    std::lock_guard<std::mutex> lock(sessionsMutex);
+    if (current) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - current->start;
+        if (elapsed.count() > 0) {lastBytesPerSecond = current->bytes / elapsed.count();}
+        std::lock_guard<std::mutex> sessionLock(current->mutex);
+        stats.inFlight += current->inFlight;
+        stats.bufferedFrames = current->bufferedFrames;
+        stats.bufferedBytes = current->bufferedBytes;
+        if (current->buffering && !current->encoded.empty()) {
+            stats.bufferedSeconds = (current->newestNs - current->encoded.begin()->second.timestampNs) / 1e9;
+        }
+    }
+    for (std::shared_ptr<Session> &session : finishing) {
+        std::lock_guard<std::mutex> sessionLock(session->mutex);
+        stats.inFlight += session->inFlight;
+    }
+    stats.flushing = finishing.size();
+    stats.bytesPerSecond = lastBytesPerSecond;
+    return stats;
+}
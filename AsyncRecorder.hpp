@@ -0,0 +1,126 @@
+#ifndef ASYNCRECORDER_HPP
+#define ASYNCRECORDER_HPP
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AviWriter.hpp"
+#include "RawVideo.hpp"
+#include "StageProfiler.hpp"
+#include "ThreadPool.hpp"
+
+enum class RecordFormat {
+    Mjpeg,          // AVI of JPEG frames, encoded in parallel
+    Raw             // Uncompressed .dkraw (see RawVideo.hpp): lossless, only disk-bound
+};
+
+struct RecorderConfig {
+    RecordFormat format = RecordFormat::Mjpeg;
+    size_t encoderThreads = 0,      // Zero means one per hardware core
+           maxInFlight = 32;        // Frames submitted but not yet written
+    bool dropWhenFull = false,      // Otherwise Submit waits for a free slot
+         greyscaleJpeg = false;     // Keep single-channel frames grey instead of
+                                    // expanding them to BGR (not every player takes it)
+    int jpegQuality = 95;
+    double preRecordSeconds = 0;    // History kept by Buffer() for the next recording (0: none)
+    size_t preRecordBytes = 256 << 20;  // Memory cap of that history
+};
+
+struct RecorderStats {
+    size_t inFlight = 0,
+           flushing = 0;            // Stopped recordings still being written
+    long long submitted = 0,
+              written = 0,
+              dropped = 0,
+              failed = 0;
+    double encodeMs = 0,            // Average JPEG encoding time
+           bytesPerSecond = 0;      // Output rate of the current recording
+    size_t bufferedFrames = 0,      // Pre-record history, or what is left of it
+           bufferedBytes = 0;       // to write once recording started
+    double bufferedSeconds = 0;
+};
+
+// Records MJPEG AVI files without encoding on the caller's thread.
+// Submitted frames are only referenced (the Mat keeps its buffer out of the
+// frame pool until it is encoded), JPEG-compressed by a pool of workers in
+// parallel and written back in submission order by one muxer thread per
+// recording. Stop() returns at once; the file is finished in the background.
+// Raw recordings skip the encoders: the muxer copies frames straight into
+// the memory-mapped file.
+// With pre-record on, frames given to Buffer() while not recording are
+// compressed the same way and kept, the oldest dropped past the time or
+// memory cap; Start() writes them ahead of the live frames, which do not
+// wait for that backlog.
+class AsyncRecorder {
+    private:
+        struct Session;
+
+        RecorderConfig config;
+        ThreadPool encoders;
+        std::shared_ptr<Session> current;
+        std::vector<std::shared_ptr<Session>> finishing;
+        std::mutex sessionsMutex;
+        std::atomic<long long> lastSessionId {0},
+                               submitted {0},
+                               written {0},
+                               dropped {0},
+                               failed {0},
+                               encodeCount {0},
+                               encodeMicroseconds {0};
+        std::atomic<bool> writeFailed {false};
+        double lastBytesPerSecond = 0;
+        StageProfiler *profiler = nullptr;
+
+        bool Enqueue(std::shared_ptr<Session> session, const cv::Mat &frame,
+                     std::chrono::steady_clock::time_point time);
+        void Encode(std::shared_ptr<Session> session, long long sequence, cv::Mat frame, int64_t timestampNs);
+        void Deliver(Session *session, long long sequence, cv::Mat raw, std::vector<uchar> jpeg, int64_t timestampNs);
+        void TrimBuffer(Session *session);
+        void MuxLoop(Session *session);
+        bool OpenSegment(Session *session, int segment);
+        void FinishSegment(Session *session, int segment);
+        void ReapFinished();
+
+    public:
+        explicit AsyncRecorder(RecorderConfig config = RecorderConfig());
+        ~AsyncRecorder();
+
+        // Stages JPEG encoding time as Stage::Record
+        void SetProfiler(StageProfiler *profiler);
+
+        // Begin a new file (stopping the current one, if any); type is what
+        // raw files store (CV_8UC3 or CV_8UC1), JPEGs are always BGR or grey
+        bool Start(const std::string &path, cv::Size size, double fps, int type = CV_8UC3);
+        bool IsRecording();
+
+        // Queue a frame of the size given to Start; false if it was dropped.
+        // Raw files keep the time as each frame's timestamp.
+        bool Submit(const cv::Mat &frame,
+                    std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now());
+
+        // Keep a frame for the next recording (only with preRecordSeconds set
+        // and while not recording); false if it wasn't kept
+        bool Buffer(const cv::Mat &frame,
+                    std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now());
+
+        // Finish the current file in the background
+        void Stop();
+
+        // True once a file couldn't be written (a full disk): that recording
+        // keeps the frames written so far and drops the rest
+        bool HasWriteFailed();
+
+        // Block until every stopped recording is on disk
+        void WaitForFlush();
+
+        RecorderStats GetStats();
+};
+
+#endif
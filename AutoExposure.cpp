@@ -0,0 +1,120 @@
+#include "AutoExposure.hpp"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <opencv2/core.hpp>
+using namespace cv;
+
+#define LUMA_B 29               // BGR->Y weights in 8-bit fixed point (sum 256)
+#define LUMA_G 150
+#define LUMA_R 77
+#define CONTRAST_STEPS 64
+
+long long AutoExposure::Histogram (const Mat &frame, int step, uint32_t histogram[256]) {
+    CV_Assert(frame.type() == CV_8UC3 || frame.type() == CV_8UC1);
+    std::fill(histogram, histogram + 256, 0);
+    step = std::max(1, step);
+    int rows = (frame.rows + step - 1) / step,
+        channels = frame.channels();
+    std::mutex mergeMutex;
+
+    parallel_for_(Range(0, rows), [&](const Range &range) {
+        // Four interleaved tables, so consecutive samples of the same value
+        // don't wait on each other's increment
+        uint32_t partial[4][256] = {};
+        for (int r = range.start; r < range.end; r++) {
+            const uchar *in = frame.ptr<uchar>(r*step);
+            int x = 0;
+            if (channels == 3) {
+                int pixelStep = 3*step;
+                for (; x + 3*step < frame.cols; x += 4*step, in += 4*pixelStep) {
+                    partial[0][(in[0]*LUMA_B + in[1]*LUMA_G + in[2]*LUMA_R + 128) >> 8]++;
+                    partial[1][(in[pixelStep]*LUMA_B + in[pixelStep + 1]*LUMA_G + in[pixelStep + 2]*LUMA_R + 128) >> 8]++;
+                    partial[2][(in[2*pixelStep]*LUMA_B + in[2*pixelStep + 1]*LUMA_G + in[2*pixelStep + 2]*LUMA_R + 128) >> 8]++;
+                    partial[3][(in[3*pixelStep]*LUMA_B + in[3*pixelStep + 1]*LUMA_G + in[3*pixelStep + 2]*LUMA_R + 128) >> 8]++;
+                }
+                for (; x < frame.cols; x += step, in += pixelStep) {
+                    partial[0][(in[0]*LUMA_B + in[1]*LUMA_G + in[2]*LUMA_R + 128) >> 8]++;
+                }
+            } else {
+                for (; x + 3*step < frame.cols; x += 4*step, in += 4*step) {
+                    partial[0][in[0]]++;
+                    partial[1][in[step]]++;
+                    partial[2][in[2*step]]++;
+                    partial[3][in[3*step]]++;
+                }
+                for (; x < frame.cols; x += step, in += step) {
+                    partial[0][in[0]]++;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        for (int v = 0; v < 256; v++) {
+            histogram[v] += partial[0][v] + partial[1][v] + partial[2][v] + partial[3][v];
+        }
+    });
+    return (long long)rows * ((frame.cols + step - 1) / step);
+}
+
+bool AutoExposure::Update (const Mat &frame) {
+    if (frame.empty()) {return false;}
+    uint32_t histogram[256];
+    long long counted = Histogram(frame, EXPOSURE_GRID_STEP, histogram);
+
+    // Levels with EXPOSURE_CLIP of the samples below and above them
+    long long clip = (long long)(counted*EXPOSURE_CLIP),
+              below = 0;
+    int frameLow = 0,
+        frameHigh = 255;
+    for (; frameLow < 255 && below + histogram[frameLow] <= clip; frameLow++) {below += histogram[frameLow];}
+    below = 0;
+    for (; frameHigh > frameLow && below + histogram[frameHigh] <= clip; frameHigh--) {below += histogram[frameHigh];}
+
+    // Follow the scene gradually, so exposure doesn't pump with every frame
+    if (low < 0) {
+        low = frameLow;
+        high = frameHigh;
+    } else {
+        low += (frameLow - low)*EXPOSURE_SMOOTHING;
+        high += (frameHigh - high)*EXPOSURE_SMOOTHING;
+    }
+
+    // Stretch [low, high] over [0, 255], around its middle when the stretch is capped
+    double newContrast = std::min(EXPOSURE_MAX_CONTRAST, 255.0 / std::max(1.0, high - low));
+    newContrast = std::max(1.0, std::round(newContrast*CONTRAST_STEPS) / CONTRAST_STEPS);
+    int newBrightness = (int)std::lround(127.5 - newContrast*(low + high)/2);
+    newBrightness = std::max(-255, std::min(newBrightness, 255));
+
+    frames++;
+    samples = counted;
+    lowShown = low;
+    highShown = high;
+    bool changed = newBrightness != brightness || (float)newContrast != contrast;
+    brightness = newBrightness;
+    contrast = (float)newContrast;
+    return changed;
+}
+
+int AutoExposure::Brightness () {
+    return brightness;
+}
+
+float AutoExposure::Contrast () {
+    return contrast;
+}
+
+void AutoExposure::Reset () {
+    low = -1;
+    high = -1;
+}
+
+ExposureStats AutoExposure::GetStats () {
+    ExposureStats stats;
+    stats.frames = frames;
+    stats.samples = samples;
+    stats.low = lowShown;
+    stats.high = highShown;
+    stats.brightness = brightness;
+    stats.contrast = contrast;
+    return stats;
+}
@@ -0,0 +1,58 @@
+#ifndef AUTOEXPOSURE_HPP
+#define AUTOEXPOSURE_HPP
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <cstdint>
+
+#define EXPOSURE_GRID_STEP 4        // Every 4th row and column: 1/16 of the pixels
+#define EXPOSURE_CLIP 0.01          // Darkest and brightest share of samples ignored
+#define EXPOSURE_SMOOTHING 0.1      // Weight of the newest frame in the running levels
+#define EXPOSURE_MAX_CONTRAST 4.0   // Stretch limit, so noise in a flat scene isn't blown up
+
+struct ExposureStats {
+    long long frames = 0,
+              samples = 0;          // Pixels the last histogram counted
+    double low = 0,                 // Running black and white levels
+           high = 255;
+    int brightness = 0;
+    float contrast = 1;
+};
+
+// Auto exposure and contrast: the luminance histogram of a sparse grid
+// of pixels gives the levels below and above which EXPOSURE_CLIP of the
+// frame lies; those levels are smoothed over frames and stretched to the
+// full range with a brightness and a contrast, to be folded into the
+// point operation tables like the sliders' values. Update() is called
+// from one thread at a time; GetStats() from any.
+class AutoExposure {
+    private:
+        double low = -1,            // Negative until the first frame
+               high = -1;
+        std::atomic<long long> frames {0},
+                               samples {0};
+        std::atomic<double> lowShown {0},
+                            highShown {255};
+        std::atomic<int> brightness {0};
+        std::atomic<float> contrast {1};
+
+    public:
+        // Luminance histogram of every step-th pixel of every step-th row
+        // of a CV_8UC3 (BGR) or CV_8UC1 frame; returns how many were counted
+        static long long Histogram(const cv::Mat &frame, int step, uint32_t histogram[256]);
+
+        // Measure a frame and move the exposure toward it; true if the
+        // brightness or contrast to apply changed
+        bool Update(const cv::Mat &frame);
+
+        // Values to apply (contrast in steps of 1/64, so a settled scene stops changing them)
+        int Brightness();
+        float Contrast();
+
+        // Start over from the next frame
+        void Reset();
+
+        ExposureStats GetStats();
+};
+
+#endif
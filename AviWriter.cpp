@@ -0,0 +1,184 @@
+#include "AviWriter.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Offsets of the fields patched when closing (see WriteHeaders)
+#define RIFF_SIZE_POS 4
+#define AVIH_MAX_BYTES_POS 36
+#define AVIH_TOTAL_FRAMES_POS 48
+#define AVIH_BUFFER_SIZE_POS 60
+#define STRH_LENGTH_POS 140
+#define STRH_BUFFER_SIZE_POS 144
+
+#define AVIF_HASINDEX 0x10
+#define AVIIF_KEYFRAME 0x10
+
+AviWriter::~AviWriter () {
+    Close();
+}
+
+void AviWriter::WriteU32 (uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+    std::fwrite(bytes, 1, 4, file);
+}
+
+void AviWriter::WriteU16 (uint16_t value) {
+    uint8_t bytes[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+    std::fwrite(bytes, 1, 2, file);
+}
+
+void AviWriter::WriteFourcc (const char *fourcc) {
+    std::fwrite(fourcc, 1, 4, file);
+}
+
+void AviWriter::PatchU32 (long long position, uint32_t value) {
+    std::fseek(file, (long)position, SEEK_SET);
+    WriteU32(value);
+}
+
+void AviWriter::WriteHeaders () {
+    // Frame rate as a fraction; integer rates stay exact
+    uint32_t scale = 1,
+             rate = (uint32_t)std::lround(fps);
+    if (std::fabs(fps - rate) > 1e-6) {
+        scale = 1000;
+        rate = (uint32_t)std::lround(fps*1000);
+    }
+
+    WriteFourcc("RIFF");
+    WriteU32(0);                            // Patched: file size - 8
+    WriteFourcc("AVI ");
+
+    WriteFourcc("LIST");
+    WriteU32(4 + 8+56 + 8+4 + 8+56 + 8+40); // hdrl
+    WriteFourcc("hdrl");
+
+    // Main header
+    WriteFourcc("avih");
+    WriteU32(56);
+    WriteU32((uint32_t)std::lround(1e6*scale/rate));   // Microseconds per frame
+    WriteU32(0);                            // Patched: max bytes per second
+    WriteU32(0);                            // Padding granularity
+    WriteU32(AVIF_HASINDEX);
+    WriteU32(0);                            // Patched: total frames
+    WriteU32(0);                            // Initial frames
+    WriteU32(1);                            // Streams
+    WriteU32(0);                            // Patched: suggested buffer size
+    WriteU32(width);
+    WriteU32(height);
+    for (int i = 0; i < 4; i++) {WriteU32(0);}
+
+    WriteFourcc("LIST");
+    WriteU32(4 + 8+56 + 8+40);              // strl
+    WriteFourcc("strl");
+
+    // Video stream header
+    WriteFourcc("strh");
+    WriteU32(56);
+    WriteFourcc("vids");
+    WriteFourcc("MJPG");
+    WriteU32(0);                            // Flags
+    WriteU16(0);                            // Priority
+    WriteU16(0);                            // Language
+    WriteU32(0);                            // Initial frames
+    WriteU32(scale);
+    WriteU32(rate);
+    WriteU32(0);                            // Start
+    WriteU32(0);                            // Patched: length in frames
+    WriteU32(0);                            // Patched: suggested buffer size
+    WriteU32(0xFFFFFFFF);                   // Quality: default
+    WriteU32(0);                            // Sample size: varies
+    WriteU16(0);
+    WriteU16(0);
+    WriteU16((uint16_t)width);
+    WriteU16((uint16_t)height);
+
+    // Video format (BITMAPINFOHEADER)
+    WriteFourcc("strf");
+    WriteU32(40);
+    WriteU32(40);
+    WriteU32(width);
+    WriteU32(height);
+    WriteU16(1);                            // Planes
+    WriteU16(24);                           // Bits per pixel
+    WriteFourcc("MJPG");
+    WriteU32(width*height*3);
+    for (int i = 0; i < 4; i++) {WriteU32(0);}
+
+    WriteFourcc("LIST");
+    WriteU32(0);                            // Patched: movi size
+    moviStart = std::ftell(file);
+    WriteFourcc("movi");
+}
+
+bool AviWriter::Open (const std::string &path, int width, int height, double fps) {
+    Close();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {return false;}
+    this->width = width;
+    this->height = height;
+    this->fps = fps > 0 ? fps : 30;
+    index.clear();
+    largestFrame = 0;
+    WriteHeaders();
+    bytesWritten = std::ftell(file);
+    return true;
+}
+
+bool AviWriter::IsOpened () {
+    return file != nullptr;
+}
+
+bool AviWriter::WriteFrame (const uint8_t *data, size_t size) {
+    if (!file) {return false;}
+    long long position = std::ftell(file);
+    WriteFourcc("00dc");
+    WriteU32((uint32_t)size);
+    std::fwrite(data, 1, size, file);
+    if (size % 2 == 1) {std::fputc(0, file);}     // Chunks are word aligned
+
+    index.push_back({(uint32_t)(position - moviStart), (uint32_t)size});
+    if (size > largestFrame) {largestFrame = (uint32_t)size;}
+    bytesWritten = std::ftell(file);
+    return !std::ferror(file);
+}
+
+void AviWriter::Close () {
+    if (!file) {return;}
+
+    long long moviEnd = std::ftell(file);
+    WriteFourcc("idx1");
+    WriteU32((uint32_t)(index.size()*16));
+    for (const IndexEntry &entry : index) {
+        WriteFourcc("00dc");
+        WriteU32(AVIIF_KEYFRAME);
+        WriteU32(entry.offset);
+        WriteU32(entry.size);
+    }
+    long long fileEnd = std::ftell(file);
+
+    uint32_t frames = (uint32_t)index.size(),
+             bufferSize = largestFrame + 8;
+    double seconds = fps > 0 ? frames / fps : 0;
+    uint32_t maxBytesPerSecond = seconds > 0 ? (uint32_t)std::min(4e9, (moviEnd - moviStart) / seconds) : 0;
+
+    PatchU32(RIFF_SIZE_POS, (uint32_t)(fileEnd - 8));
+    PatchU32(AVIH_MAX_BYTES_POS, maxBytesPerSecond);
+    PatchU32(AVIH_TOTAL_FRAMES_POS, frames);
+    PatchU32(AVIH_BUFFER_SIZE_POS, bufferSize);
+    PatchU32(STRH_LENGTH_POS, frames);
+    PatchU32(STRH_BUFFER_SIZE_POS, bufferSize);
+    PatchU32(moviStart - 4, (uint32_t)(moviEnd - moviStart));
+
+    std::fclose(file);
+    file = nullptr;
+    bytesWritten = fileEnd;
+}
+
+long long AviWriter::FramesWritten () {
+    return (long long)index.size();
+}
+
+long long AviWriter::BytesWritten () {
+    return bytesWritten;
+}
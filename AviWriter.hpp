@@ -0,0 +1,52 @@
+#ifndef AVIWRITER_HPP
+#define AVIWRITER_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Minimal AVI 1.0 muxer for already compressed MJPEG frames.
+// Sizes in AVI 1.0 are 32-bit, so callers should start a new file
+// before BytesWritten() reaches AVI_MAX_BYTES.
+#define AVI_MAX_BYTES 0x7F000000LL
+
+class AviWriter {
+    private:
+        struct IndexEntry {
+            uint32_t offset,
+                     size;
+        };
+
+        std::FILE *file = nullptr;
+        std::vector<IndexEntry> index;
+        long long moviStart = 0,        // Position of the 'movi' fourcc
+                  bytesWritten = 0;
+        uint32_t largestFrame = 0;
+        int width = 0,
+            height = 0;
+        double fps = 0;
+
+        void WriteU32(uint32_t value);
+        void WriteU16(uint16_t value);
+        void WriteFourcc(const char *fourcc);
+        void PatchU32(long long position, uint32_t value);
+        void WriteHeaders();
+
+    public:
+        ~AviWriter();
+
+        bool Open(const std::string &path, int width, int height, double fps);
+        bool IsOpened();
+
+        // One JPEG image per call
+        bool WriteFrame(const uint8_t *data, size_t size);
+
+        // Writes the index and final sizes
+        void Close();
+
+        long long FramesWritten();
+        long long BytesWritten();
+};
+
+#endif
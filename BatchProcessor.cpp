@@ -0,0 +1,106 @@
+#include "BatchProcessor.hpp"
+#include "FrameSource.hpp"
+#include "ThreadPool.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <set>
+using namespace cv;
+
+BatchProcessor::BatchProcessor (FilterSpec spec, std::string outputDir, size_t threads)
+    : spec(spec), outputDir(outputDir), threads(threads) {
+}
+
+std::vector<BatchResult> BatchProcessor::Run (const std::vector<std::string> &inputs) {
+    std::vector<BatchResult> results(inputs.size());
+    ThreadPool pool(threads);
+
+    // Inputs with the same name from different folders would write the same
+    // file at once: later ones get a numbered suffix, in the order given
+    std::vector<std::string> outputs(inputs.size());
+    std::set<std::string> used;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        std::string stem = std::filesystem::path(inputs[i]).stem().string(),
+                    name = stem;
+        for (int n = 2; !used.insert(name).second; n++) {name = stem + "_" + std::to_string(n);}
+        outputs[i] = (std::filesystem::path(outputDir) / name).string() + ".avi";
+    }
+
+    // With enough files to fill every core, keep OpenCV from spawning its own threads
+    if (inputs.size() >= pool.Size()) {setNumThreads(1);}
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        pool.Submit([this, &inputs, &outputs, &results, i]() {
+            results[i] = ProcessFile(inputs[i], outputs[i]);
+            Report(results[i]);
+        });
+    }
+    pool.Wait();
+    return results;
+}
+
+BatchResult BatchProcessor::ProcessFile (const std::string &input, const std::string &output) {
+    BatchResult result;
+    result.input = input;
+    result.output = output;
+
+    // Decoded ahead on its own thread while the previous frame is filtered
+    std::unique_ptr<FrameSource> source = FrameSource::Open(input);
+    if (!source) {
+        result.error = "failed to open input";
+        return result;
+    }
+    // A batch has to finish: no cameras, and synthetic inputs need a frame count
+    if (source->IsEndless()) {
+        result.error = "endless input (camera, or synthetic without FRAMES)";
+        return result;
+    }
+    double fps = source->Fps();
+    if (fps <= 0) {fps = 30;}
+
+    VideoManager videoManager;
+    spec.ApplyTo(videoManager);
+
+    VideoWriter video;
+    Mat frame,
+        bgr;
+    auto start = std::chrono::steady_clock::now();
+    while (source->Read(frame)) {
+        videoManager.SetFrame(frame);
+        videoManager.UpdateFrame();
+
+        // Output keeps the zoom and rotation, like the "Edited" preview.
+        // The writer takes BGR only, so greyscale frames are expanded here.
+        Mat newFrame = videoManager.GetRedimensionedFrame();
+        if (newFrame.channels() == 1) {
+            cvtColor(newFrame, bgr, COLOR_GRAY2BGR);
+            newFrame = bgr;
+        }
+        if (!video.isOpened()) {
+            video.open(result.output, VideoWriter::fourcc('M', 'J', 'P', 'G'), fps, newFrame.size());
+            if (!video.isOpened()) {
+                result.error = "failed to open output";
+                return result;
+            }
+        }
+        video.write(newFrame);
+        result.frames++;
+    }
+    video.release();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.ok = true;
+    return result;
+}
+
+void BatchProcessor::Report (const BatchResult &result) {
+    std::lock_guard<std::mutex> lock(reportMutex);
+    if (!result.ok) {
+        std::cout << result.input << ": " << result.error << std::endl;
+        return;
+    }
+    double fps = result.seconds > 0 ? result.frames / result.seconds : 0;
+    std::cout << result.input << " -> " << result.output << ": "
+              << result.frames << " frames in " << result.seconds << " s ("
+              << fps << " fps)" << std::endl;
+}
@@ -0,0 +1,37 @@
+#ifndef BATCHPROCESSOR_HPP
+#define BATCHPROCESSOR_HPP
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "FilterSpec.hpp"
+
+struct BatchResult {
+    std::string input,
+                output,
+                error;
+    long long frames = 0;
+    double seconds = 0;
+    bool ok = false;
+};
+
+// Applies one FilterSpec to many video files at once, one file per worker.
+// Uses only OpenCV core/imgproc/videoio: no Qt and no highgui.
+class BatchProcessor {
+    private:
+        FilterSpec spec;
+        std::string outputDir;
+        size_t threads;
+        std::mutex reportMutex;
+
+        BatchResult ProcessFile(const std::string &input, const std::string &output);
+        void Report(const BatchResult &result);
+
+    public:
+        // Zero threads means one per hardware core
+        BatchProcessor(FilterSpec spec, std::string outputDir, size_t threads = 0);
+
+        std::vector<BatchResult> Run(const std::vector<std::string> &inputs);
+};
+
+#endif
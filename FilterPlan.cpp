@@ -0,0 +1,62 @@
+#include "FilterPlan.hpp"
+#include <algorithm>
+#include <cmath>
+#include <opencv2/core.hpp>
+
+// Odd Gaussian kernel whose sigma is closest to the given kernel's sigma
+// divided by factor (sigma = 0.3*((ksize-1)*0.5 - 1) + 0.8, as in OpenCV)
+static int ScaledGaussianKernel (int kernelSize, double factor) {
+    double sigma = (0.3*((kernelSize - 1)*0.5 - 1) + 0.8) / factor;
+    double half = (sigma - 0.8)/0.3 + 1;
+    return 2*(int)std::lround(std::max(0.0, half)) + 1;
+}
+
+FilterPlan::FilterPlan (const FilterSettings &settings, uint64_t generation)
+    : settings(settings),
+      generation(generation) {
+    pointLut.Build(settings.contrast, settings.brightness, settings.negativeFilter, settings.greyScale);
+    gaussianKernelSizes[0] = settings.gaussianKernelSize;
+    for (int halvings = 1; halvings < PLAN_GAUSSIAN_SCALES; halvings++) {
+        gaussianKernelSizes[halvings] = ScaledGaussianKernel(settings.gaussianKernelSize, std::ldexp(1.0, halvings));
+    }
+    bool mirror = settings.mirrorH || settings.mirrorV,
+         pointOps = !pointLut.IsIdentity() || settings.autoExposure,
+         resize = settings.zoomOut > 0 || settings.rotation != 0;
+
+    // Full resolution: mirror, filters, then zoom out and rotation
+    bool temporal = settings.temporalMode != TemporalMode::Off;
+    if (temporal) {fullResolutionSteps.push_back(PlanStep::Temporal);}
+    if (mirror) {fullResolutionSteps.push_back(PlanStep::Mirror);}
+    if (pointOps) {fullResolutionSteps.push_back(PlanStep::PointOps);}
+    if (settings.gaussianFilter) {fullResolutionSteps.push_back(PlanStep::Gaussian);}
+    if (settings.edgeDetection) {fullResolutionSteps.push_back(PlanStep::EdgeDetection);}
+    if (settings.gradientFilter) {fullResolutionSteps.push_back(PlanStep::Gradient);}
+    if (resize) {fullResolutionSteps.push_back(PlanStep::GeometryLast);}
+
+    // Preview only: shrink first, unless a filter depends on the pixel scale
+    bool geometryFirst = !settings.edgeDetection && !settings.gradientFilter;
+    if (temporal) {previewSteps.push_back(PlanStep::Temporal);}
+    if (geometryFirst && HasGeometry()) {previewSteps.push_back(PlanStep::GeometryFirst);}
+    if (pointOps) {previewSteps.push_back(PlanStep::PointOps);}
+    if (settings.gaussianFilter) {previewSteps.push_back(PlanStep::Gaussian);}
+    if (settings.edgeDetection) {previewSteps.push_back(PlanStep::EdgeDetection);}
+    if (settings.gradientFilter) {previewSteps.push_back(PlanStep::Gradient);}
+    if (!geometryFirst && HasGeometry()) {previewSteps.push_back(PlanStep::GeometryLast);}
+}
+
+bool FilterPlan::HasGeometry () const {
+    return settings.mirrorH || settings.mirrorV || settings.zoomOut > 0 || settings.rotation != 0;
+}
+
+int FilterPlan::GaussianKernelSize (int halvings) const {
+    return gaussianKernelSizes[std::max(0, std::min(halvings, PLAN_GAUSSIAN_SCALES - 1))];
+}
+
+// Greyscale and edge detection leave a single channel, which every later step keeps
+int FilterPlan::OutputType (PlanStep step, int inputType) const {
+    if (step == PlanStep::PointOps && (inputType == CV_8UC3 || inputType == CV_8UC1)) {
+        return CV_MAKETYPE(CV_8U, pointLut.OutputChannels(CV_MAT_CN(inputType)));
+    }
+    if (step == PlanStep::EdgeDetection) {return CV_8UC1;}
+    return inputType;
+}
@@ -0,0 +1,72 @@
+#ifndef FILTERPLAN_HPP
+#define FILTERPLAN_HPP
+
+#include <cstdint>
+#include <vector>
+#include "PointLut.hpp"
+#include "TemporalFilter.hpp"
+
+// Every setting the UI can change on a VideoManager
+struct FilterSettings {
+    int rotation = 0,
+        zoomOut = 0,
+        gaussianKernelSize = 3,
+        brightness = 0;
+    float contrast = 1,
+          temporalBlend = 0.25f;    // Trail: weight of the newest frame; motion: of the frame under it
+    TemporalMode temporalMode = TemporalMode::Off;
+    int temporalWindow = 8;         // Frames averaged (denoise, motion highlight)
+    bool mirrorH = false,
+        mirrorV = false,
+        greyScale = false,
+        edgeDetection = false,
+        negativeFilter = false,
+        gradientFilter = false,
+        gaussianFilter = false,
+        autoExposure = false;       // Brightness and contrast follow the scene instead
+};
+
+// One step of UpdateFrame
+enum class PlanStep {
+    Temporal,           // On the captured frame, so the history doesn't follow the other settings
+    Mirror,             // Full-resolution mirror
+    GeometryFirst,      // Mirror, zoom out and rotation before the filters
+    PointOps,           // Brightness, contrast, greyscale and negative
+    Gaussian,
+    EdgeDetection,
+    Gradient,
+    GeometryLast        // Zoom out and rotation (plus mirror if not done yet)
+};
+
+#define PLAN_GAUSSIAN_SCALES 16     // Halvings a Gaussian kernel size is kept for
+
+// Settings compiled into what UpdateFrame has to run: only the active
+// steps, in order, with the point operation tables and the Gaussian
+// kernel size for every frame scale already worked out. Buffer sizes
+// still come from the frame (the pool reuses them); their types follow
+// from the plan alone. A plan never changes after construction, so the
+// processing thread can read it while the UI compiles the next one.
+class FilterPlan {
+    private:
+        int gaussianKernelSizes[PLAN_GAUSSIAN_SCALES];
+
+    public:
+        const FilterSettings settings;
+        const uint64_t generation;                  // Grows with every settings change
+        PointLut pointLut;
+        std::vector<PlanStep> fullResolutionSteps,  // When the full-resolution frame is kept
+                              previewSteps;         // When only the redimensioned frame is
+
+        explicit FilterPlan(const FilterSettings &settings, uint64_t generation = 0);
+
+        bool HasGeometry() const;
+
+        // Kernel size giving the same blur on a frame halved that many
+        // times as the chosen one at full resolution (1: none left)
+        int GaussianKernelSize(int halvings) const;
+
+        // Frame type a step outputs for the given input type
+        int OutputType(PlanStep step, int inputType) const;
+};
+
+#endif
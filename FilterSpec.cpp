@@ -0,0 +1,21 @@
+#include "FilterSpec.hpp"
+
+void FilterSpec::ApplyTo (VideoManager &videoManager) const {
+    videoManager.Reset();
+    if (mirrorH) {videoManager.MirrorHorizontal();}
+    if (mirrorV) {videoManager.MirrorVertical();}
+    if (rotation != 0) {videoManager.AdjustRotation(rotation);}
+    for (int i = 0; i < zoomOut; i++) {videoManager.ZoomOut();}
+    videoManager.AdjustBrightness(brightness);
+    videoManager.AdjustContrast(contrast);
+    if (greyScale) {videoManager.AlterGreyscale();}
+    if (negative) {videoManager.AlterNegativeFilter();}
+    if (edgeDetection) {videoManager.AlterEdgeDetection();}
+    if (gradient) {videoManager.AlterGradientFilter();}
+    if (autoExposure) {videoManager.AlterAutoExposure();}
+    if (gaussianKernelSize > 0) {videoManager.ActivateGaussianFilter(gaussianKernelSize);}
+    if (denoiseFrames > 0) {
+        videoManager.AdjustTemporalWindow(denoiseFrames);
+        videoManager.SetTemporalMode(TemporalMode::Average);
+    }
+}
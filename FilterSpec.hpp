@@ -0,0 +1,25 @@
+#ifndef FILTERSPEC_HPP
+#define FILTERSPEC_HPP
+
+#include "VideoManager.hpp"
+
+// Every VideoManager setting in one place (command line, benchmarks)
+struct FilterSpec {
+    bool mirrorH = false,
+         mirrorV = false,
+         greyScale = false,
+         negative = false,
+         edgeDetection = false,
+         gradient = false,
+         autoExposure = false;
+    int rotation = 0,
+        zoomOut = 0,
+        brightness = 0,
+        gaussianKernelSize = 0,     // 0 means no Gaussian filter
+        denoiseFrames = 0;          // Temporal denoise window, 0 means none
+    float contrast = 1;
+
+    void ApplyTo(VideoManager &videoManager) const;
+};
+
+#endif
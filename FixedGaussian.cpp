@@ -0,0 +1,234 @@
+#include "FixedGaussian.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <opencv2/imgproc.hpp>
+using namespace cv;
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GAUSSIAN_FRACTION_BITS 8
+#define GAUSSIAN_ONE (1 << GAUSSIAN_FRACTION_BITS)
+
+// std::exp is not constexpr. exp(x) = exp(x/1024)^1024, and the series
+// needs few terms for such small arguments.
+static constexpr double ConstExp (double x) {
+    double y = x / 1024,
+           term = 1,
+           sum = 1;
+    for (int i = 1; i < 12; i++) {
+        term *= y / i;
+        sum += term;
+    }
+    for (int i = 0; i < 10; i++) {sum *= sum;}
+    return sum;
+}
+
+// getGaussianKernel(K, 0): a fixed table up to 7 taps, above that
+// exp(-x^2/(2 sigma^2)) with sigma = 0.3*((K - 1)/2 - 1) + 0.8, normalized.
+// Rounded to 8.8 fixed point from the outer taps in, each rounding error
+// carried to the next tap; the center tap takes the rest, so the taps
+// always add up to exactly one.
+template <int K>
+static constexpr std::array<uint16_t, K> MakeTaps () {
+    constexpr int r = K/2;
+    const double small[3][7] = {{0.25, 0.5, 0.25},
+                                {0.0625, 0.25, 0.375, 0.25, 0.0625},
+                                {0.03125, 0.109375, 0.21875, 0.28125, 0.21875, 0.109375, 0.03125}};
+    double kernel[K] = {};
+    if (K <= 7) {
+        for (int i = 0; i < K; i++) {kernel[i] = small[r - 1][i];}
+    } else {
+        double sigma = 0.3*((K - 1)*0.5 - 1) + 0.8,
+               sum = 0;
+        for (int i = 0; i < K; i++) {
+            double x = i - r;
+            kernel[i] = ConstExp(-x*x / (2*sigma*sigma));
+            sum += kernel[i];
+        }
+        for (int i = 0; i < K; i++) {kernel[i] /= sum;}
+    }
+
+    std::array<uint16_t, K> taps {};
+    int side = 0;
+    double error = 0;
+    for (int i = 0; i < r; i++) {
+        double scaled = kernel[i]*GAUSSIAN_ONE + error;
+        int tap = (int)(scaled + 0.5);
+        error = scaled - tap;
+        taps[i] = taps[K - 1 - i] = (uint16_t)tap;
+        side += tap;
+    }
+    taps[r] = (uint16_t)(GAUSSIAN_ONE - 2*side);
+    return taps;
+}
+
+template <int K>
+struct GaussianTaps {
+    static constexpr std::array<uint16_t, K> values = MakeTaps<K>();
+};
+
+static_assert(GaussianTaps<7>::values[0] == 8 && GaussianTaps<7>::values[3] == 72,
+              "Small kernels are OpenCV's table, exact in 8.8");
+
+
+// Row pass: out[i] = sum of taps[k]*p[i + k*cn], with p padded by K/2
+// pixels on each side. Symmetric taps are applied to the sum of both pixels.
+// At most 255*GAUSSIAN_ONE, so it fits 16 bits.
+template <int K, size_t... k>
+static inline uint16_t RowAt (const uchar *p, int cn, std::index_sequence<k...>) {
+    constexpr int r = K/2;
+    constexpr const std::array<uint16_t, K> &taps = GaussianTaps<K>::values;
+    return (uint16_t)(taps[r]*p[r*cn] + ((taps[k]*(p[k*cn] + p[(K - 1 - k)*cn])) + ... + 0));
+}
+
+// Column pass: the K filtered rows around the output row, 16 fraction bits
+// in total, rounded once
+template <int K, size_t... k>
+static inline uchar ColumnAt (const uint16_t *const *rows, int i, std::index_sequence<k...>) {
+    constexpr int r = K/2;
+    constexpr const std::array<uint16_t, K> &taps = GaussianTaps<K>::values;
+    uint32_t sum = (uint32_t)taps[r]*rows[r][i]
+                 + (((uint32_t)taps[k]*(rows[k][i] + rows[K - 1 - k][i])) + ... + 0u);
+    return (uchar)((sum + (1u << (2*GAUSSIAN_FRACTION_BITS - 1))) >> (2*GAUSSIAN_FRACTION_BITS));
+}
+
+#ifdef __SSE2__
+// The same, 8 values per step (16-bit lanes wrap, but the row sum fits)
+template <int K, size_t... k>
+static inline __m128i RowSse2 (const uchar *p, int cn, std::index_sequence<k...>) {
+    constexpr int r = K/2;
+    constexpr const std::array<uint16_t, K> &taps = GaussianTaps<K>::values;
+    const __m128i zero = _mm_setzero_si128();
+    auto load = [&zero](const uchar *q) {
+        return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)q), zero);
+    };
+    __m128i sum = _mm_mullo_epi16(load(p + r*cn), _mm_set1_epi16((short)taps[r]));
+    ((sum = _mm_add_epi16(sum, _mm_mullo_epi16(_mm_add_epi16(load(p + k*cn), load(p + (K - 1 - k)*cn)),
+                                               _mm_set1_epi16((short)taps[k])))), ...);
+    return sum;
+}
+
+// Row values don't leave room to add two before multiplying, so every tap
+// gets its own 16x16 -> 32-bit product
+template <int K, size_t... k>
+static inline void ColumnSse2 (const uint16_t *const *rows, int i, uchar *out, std::index_sequence<k...>) {
+    constexpr const std::array<uint16_t, K> &taps = GaussianTaps<K>::values;
+    __m128i low = _mm_set1_epi32(1 << (2*GAUSSIAN_FRACTION_BITS - 1)),
+            high = low;
+    auto add = [&low, &high](const uint16_t *row, uint16_t tap) {
+        __m128i v = _mm_loadu_si128((const __m128i*)row),
+                t = _mm_set1_epi16((short)tap),
+                productLow = _mm_mullo_epi16(v, t),
+                productHigh = _mm_mulhi_epu16(v, t);
+        low = _mm_add_epi32(low, _mm_unpacklo_epi16(productLow, productHigh));
+        high = _mm_add_epi32(high, _mm_unpackhi_epi16(productLow, productHigh));
+    };
+    (add(rows[k] + i, taps[k]), ...);
+    low = _mm_srli_epi32(low, 2*GAUSSIAN_FRACTION_BITS);
+    high = _mm_srli_epi32(high, 2*GAUSSIAN_FRACTION_BITS);
+    __m128i packed = _mm_packs_epi32(low, high);
+    _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(packed, packed));
+}
+#endif
+
+// One source row, reflected into padded, filtered into out
+template <int K>
+static void FilterRow (const uchar *src, uchar *padded, uint16_t *out, int cols, int cn) {
+    constexpr int r = K/2;
+    int width = cols*cn;
+    std::copy(src, src + width, padded + r*cn);
+    for (int j = 1; j <= r; j++) {
+        std::copy(src + j*cn, src + (j + 1)*cn, padded + (r - j)*cn);
+        std::copy(src + (cols - 1 - j)*cn, src + (cols - j)*cn, padded + (r + cols - 1 + j)*cn);
+    }
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 8 <= width; i += 8) {
+        _mm_storeu_si128((__m128i*)(out + i), RowSse2<K>(padded + i, cn, std::make_index_sequence<r>()));
+    }
+#endif
+    for (; i < width; i++) {
+        out[i] = RowAt<K>(padded + i, cn, std::make_index_sequence<r>());
+    }
+}
+
+template <int K>
+static void FilterColumn (const uint16_t *const *rows, uchar *out, int width) {
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 8 <= width; i += 8) {
+        ColumnSse2<K>(rows, i, out, std::make_index_sequence<K>());
+    }
+#endif
+    for (; i < width; i++) {
+        out[i] = ColumnAt<K>(rows, i, std::make_index_sequence<K/2>());
+    }
+}
+
+// BORDER_REFLECT_101, for images larger than the kernel's radius
+static inline int Reflect101 (int i, int size) {
+    if (i < 0) {return -i;}
+    if (i >= size) {return 2*size - i - 2;}
+    return i;
+}
+
+// Bands of rows in parallel; each keeps its last K filtered rows in a ring,
+// so every source row is filtered horizontally once (plus K - 1 per band)
+template <int K>
+static void Blur (const Mat &src, Mat &dst) {
+    constexpr int r = K/2;
+    int cn = src.channels(),
+        cols = src.cols,
+        rows = src.rows,
+        width = cols*cn;
+
+    parallel_for_(Range(0, rows), [&](const Range &range) {
+        // Reused by later calls on the same thread
+        thread_local std::vector<uint16_t> window;
+        thread_local std::vector<uchar> padded;
+        window.resize((size_t)K*width);
+        padded.resize((size_t)(cols + 2*r)*cn);
+
+        auto filterRow = [&](int y) {
+            FilterRow<K>(src.ptr<uchar>(Reflect101(y, rows)), padded.data(),
+                         window.data() + (size_t)((y + r) % K)*width, cols, cn);
+        };
+        for (int y = range.start - r; y < range.start + r; y++) {filterRow(y);}
+        const uint16_t *around[K];
+        for (int y = range.start; y < range.end; y++) {
+            filterRow(y + r);
+            for (int k = 0; k < K; k++) {around[k] = window.data() + (size_t)((y + k) % K)*width;}
+            FilterColumn<K>(around, dst.ptr<uchar>(y), width);
+        }
+    }, std::max(1, rows / (4*K)));
+}
+
+
+bool FixedGaussian::IsSupported (int kernelSize) {
+    return kernelSize >= 3 && kernelSize <= 15 && kernelSize % 2 == 1;
+}
+
+void FixedGaussian::Apply (const Mat &src, Mat &dst, int kernelSize) {
+    int radius = kernelSize / 2;
+    if (!IsSupported(kernelSize) || src.depth() != CV_8U || src.cols <= radius || src.rows <= radius
+        || (!dst.empty() && dst.data == src.data)) {
+        GaussianBlur(src, dst, Size(kernelSize, kernelSize), 0, 0, BORDER_DEFAULT | BORDER_ISOLATED);
+        return;
+    }
+
+    dst.create(src.size(), src.type());
+    switch (kernelSize) {
+    case 3:     Blur<3>(src, dst);  break;
+    case 5:     Blur<5>(src, dst);  break;
+    case 7:     Blur<7>(src, dst);  break;
+    case 9:     Blur<9>(src, dst);  break;
+    case 11:    Blur<11>(src, dst); break;
+    case 13:    Blur<13>(src, dst); break;
+    case 15:    Blur<15>(src, dst); break;
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef FIXEDGAUSSIAN_HPP
+#define FIXEDGAUSSIAN_HPP
+
+#include <opencv2/core.hpp>
+
+// Gaussian blur of 8-bit images for the kernel sizes the Gaussian slider
+// offers (3 to 15), with one specialization per size: the taps are 8.8
+// fixed point computed at compile time, and both separable passes are
+// unrolled for them. Like OpenCV's own 8-bit path, rows are filtered to
+// 16-bit and columns to 32-bit before rounding once, so the output matches
+// GaussianBlur with sigma 0 and BORDER_REFLECT_101 within 1 (DuckyVideoBench
+// checks it before timing anything).
+class FixedGaussian {
+    public:
+        static bool IsSupported(int kernelSize);
+
+        // Other sizes and depths, images smaller than the kernel and
+        // in-place calls go to cv::GaussianBlur; dst is reused if its shape matches
+        static void Apply(const cv::Mat &src, cv::Mat &dst, int kernelSize);
+};
+
+#endif
@@ -0,0 +1,45 @@
+#include "FramePool.hpp"
+using namespace cv;
+
+FramePool::FramePool (size_t maxPerShape)
+    : maxPerShape(maxPerShape) {
+}
+
+Mat FramePool::Acquire (Size size, int type) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (++acquires % FRAME_POOL_SWEEP_INTERVAL == 0) {DropIdleShapes();}
+    Shape &shape = shapes[std::make_tuple(size.width, size.height, type)];
+    shape.lastAcquire = acquires;
+
+    // Free when the pool holds the only reference
+    for (Mat &buffer : shape.buffers) {
+        if (CV_XADD(&buffer.u->refcount, 0) == 1) {return buffer;}
+    }
+
+    Mat fresh(size, type);
+    if (shape.buffers.size() < maxPerShape) {shape.buffers.push_back(fresh);}
+    return fresh;
+}
+
+// Called with poolMutex held
+void FramePool::DropIdleShapes () {
+    for (auto it = shapes.begin(); it != shapes.end();) {
+        if (acquires - it->second.lastAcquire > FRAME_POOL_IDLE_ACQUIRES) {
+            it = shapes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+size_t FramePool::Count () {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    size_t count = 0;
+    for (auto &shape : shapes) {count += shape.second.buffers.size();}
+    return count;
+}
+
+void FramePool::Clear () {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    shapes.clear();
+}
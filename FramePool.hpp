@@ -0,0 +1,47 @@
+#ifndef FRAMEPOOL_HPP
+#define FRAMEPOOL_HPP
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#define FRAME_POOL_IDLE_ACQUIRES 4096     // A shape not asked for in that many acquires is dropped
+#define FRAME_POOL_SWEEP_INTERVAL 256
+
+// Reusable frame buffers, grouped by size and type.
+// A buffer is handed out again once every Mat returned for it was dropped
+// (OpenCV's own reference count tells when), so frames can travel through
+// queues and threads without anyone returning them explicitly.
+// Shapes nobody asked for in the last FRAME_POOL_IDLE_ACQUIRES acquires
+// (an old capture size, proxy or quality level) are let go, so memory
+// follows the shapes in use; buffers still held elsewhere live on until
+// their last Mat is dropped.
+class FramePool {
+    private:
+        struct Shape {
+            std::vector<cv::Mat> buffers;
+            uint64_t lastAcquire = 0;
+        };
+
+        std::map<std::tuple<int, int, int>, Shape> shapes;
+        std::mutex poolMutex;
+        size_t maxPerShape;
+        uint64_t acquires = 0;
+
+        void DropIdleShapes();
+
+    public:
+        // Past maxPerShape buffers in use, new ones are not kept
+        explicit FramePool(size_t maxPerShape = 64);
+
+        cv::Mat Acquire(cv::Size size, int type);
+
+        // Buffers currently owned by the pool
+        size_t Count();
+        void Clear();
+};
+
+#endif
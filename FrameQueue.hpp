@@ -0,0 +1,150 @@
+#ifndef FRAMEQUEUE_HPP
+#define FRAMEQUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// What a full queue does when the producer pushes a new item
+enum class QueuePolicy {
+    Block,          // Producer waits for the consumer to free a slot
+    DropOldest      // Producer discards the oldest queued item
+};
+
+struct QueueStats {
+    size_t depth = 0,
+           capacity = 0;
+    uint64_t pushed = 0,
+             dropped = 0;
+};
+
+// Bounded lock-free ring buffer connecting two pipeline stages.
+// It is meant for one producer and one consumer thread; each slot carries a
+// sequence number so that, with DropOldest, the producer can also pop the
+// oldest item without racing the consumer.
+template <typename T>
+class FrameQueue {
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        std::unique_ptr<Cell[]> cells;
+        size_t mask;
+        QueuePolicy policy;
+        alignas(64) std::atomic<size_t> enqueuePos {0};
+        alignas(64) std::atomic<size_t> dequeuePos {0};
+        alignas(64) std::atomic<uint64_t> pushed {0},
+                                          dropped {0};
+        std::atomic<bool> closed {false};
+
+        static size_t RoundUpPowerOfTwo (size_t value) {
+            size_t result = 2;
+            while (result < value) {result <<= 1;}
+            return result;
+        }
+
+        bool TryEnqueue (T &item) {
+            size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            if (seq != pos) {return false;}  // Full, or consumer still reading this slot
+            cell.data = std::move(item);
+            cell.sequence.store(pos + 1, std::memory_order_release);
+            enqueuePos.store(pos + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        static void Backoff () {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+    public:
+        explicit FrameQueue (size_t capacity, QueuePolicy policy = QueuePolicy::Block)
+            : policy(policy) {
+            size_t size = RoundUpPowerOfTwo(capacity);
+            cells.reset(new Cell[size]);
+            for (size_t i = 0; i < size; i++) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            mask = size - 1;
+        }
+
+        FrameQueue (const FrameQueue&) = delete;
+        FrameQueue& operator= (const FrameQueue&) = delete;
+
+        // Returns false only if the queue was closed
+        bool Push (T item) {
+            while (!closed.load(std::memory_order_acquire)) {
+                if (TryEnqueue(item)) {
+                    pushed.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                if (policy == QueuePolicy::DropOldest) {
+                    T discarded;
+                    if (TryPop(discarded)) {
+                        dropped.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                }
+                Backoff();
+            }
+            return false;
+        }
+
+        // Non-blocking; returns false if the queue is empty
+        bool TryPop (T &item) {
+            size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            Cell *cell;
+            for (;;) {
+                cell = &cells[pos & mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+                if (dif == 0) {
+                    if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {break;}
+                } else if (dif < 0) {
+                    return false;
+                } else {
+                    pos = dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+            item = std::move(cell->data);
+            cell->data = T();
+            cell->sequence.store(pos + mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Waits for an item; returns false once the queue is closed and drained
+        bool Pop (T &item) {
+            for (;;) {
+                if (TryPop(item)) {return true;}
+                if (closed.load(std::memory_order_acquire)) {return TryPop(item);}
+                Backoff();
+            }
+        }
+
+        void Close () {
+            closed.store(true, std::memory_order_release);
+        }
+
+        bool IsClosed () {
+            return closed.load(std::memory_order_acquire);
+        }
+
+        QueueStats GetStats () {
+            QueueStats stats;
+            size_t in = enqueuePos.load(std::memory_order_relaxed),
+                   out = dequeuePos.load(std::memory_order_relaxed);
+            stats.depth = in > out ? in - out : 0;
+            stats.capacity = mask + 1;
+            stats.pushed = pushed.load(std::memory_order_relaxed);
+            stats.dropped = dropped.load(std::memory_order_relaxed);
+            return stats;
+        }
+};
+
+#endif
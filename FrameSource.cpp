@@ -0,0 +1,232 @@
+#include "FrameSource.hpp"
+#include "FrameTracer.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+using namespace cv;
+
+static bool IsCameraIndex (const std::string &spec) {
+    return !spec.empty() && std::all_of(spec.begin(), spec.end(), [](char c) {return std::isdigit((unsigned char)c);});
+}
+
+static std::unique_ptr<FrameSource> Prefetched (std::unique_ptr<FrameSource> source, size_t frames) {
+    if (frames == 0) {return source;}
+    return std::unique_ptr<FrameSource>(new PrefetchSource(std::move(source), frames));
+}
+
+std::unique_ptr<FrameSource> FrameSource::Open (const std::string &spec, size_t prefetchFrames) {
+    if (IsCameraIndex(spec)) {
+        std::unique_ptr<CameraSource> camera(new CameraSource(std::stoi(spec)));
+        if (!camera->IsOpened()) {return nullptr;}
+        return camera;
+    }
+
+    std::error_code error;
+    if (std::filesystem::is_directory(spec, error)) {
+        std::unique_ptr<ImageSequenceSource> images(new ImageSequenceSource(spec));
+        if (images->FileCount() == 0) {return nullptr;}
+        return Prefetched(std::move(images), prefetchFrames);
+    }
+
+    // Only a name that isn't an existing file is a test pattern
+    if (spec.rfind("synthetic", 0) == 0 && !std::filesystem::exists(spec, error)) {
+        Size size(SYNTHETIC_WIDTH, SYNTHETIC_HEIGHT);
+        long long frames = 0;
+        if (spec.size() > 9) {
+            int fields = std::sscanf(spec.c_str(), "synthetic:%dx%d:%lld", &size.width, &size.height, &frames);
+            if (fields < 2 || size.width <= 0 || size.height <= 0 || frames < 0) {return nullptr;}
+        }
+        return std::unique_ptr<FrameSource>(new SyntheticSource(size, frames));
+    }
+
+    std::unique_ptr<VideoFileSource> file(new VideoFileSource(spec));
+    if (!file->IsOpened()) {return nullptr;}
+    return Prefetched(std::move(file), prefetchFrames);
+}
+
+
+// Camera or video file
+bool CaptureSource::Read (Mat &frame) {
+    // A buffer nobody holds any more (same shape as the last frame)
+    frame = frameSize.area() > 0 ? pool.Acquire(frameSize, frameType) : Mat();
+    cap >> frame;
+    if (frame.empty()) {return false;}
+    frameSize = frame.size();
+    frameType = frame.type();
+    return true;
+}
+
+double CaptureSource::Fps () {
+    return cap.get(CAP_PROP_FPS) > 0 ? cap.get(CAP_PROP_FPS) : 0;
+}
+
+bool CaptureSource::IsLive () {
+    return live;
+}
+
+bool CaptureSource::IsEndless () {
+    return live;
+}
+
+bool CaptureSource::IsOpened () {
+    return cap.isOpened();
+}
+
+CameraSource::CameraSource (int index) {
+    live = true;
+    cap.open(index);
+}
+
+VideoFileSource::VideoFileSource (const std::string &path) {
+    cap.open(path);
+}
+
+
+// Folder of images
+ImageSequenceSource::ImageSequenceSource (const std::string &directory, double fps)
+    : fps(fps) {
+    const std::vector<std::string> extensions = {".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".ppm", ".pgm", ".webp"};
+    std::error_code error;
+    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory, error)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {return std::tolower(c);});
+        if (entry.is_regular_file(error) && std::find(extensions.begin(), extensions.end(), extension) != extensions.end()) {
+            files.push_back(entry.path().string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+}
+
+bool ImageSequenceSource::ReadFile (const std::string &path) {
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) {return false;}
+    bool ok = std::fseek(file, 0, SEEK_END) == 0;
+    long size = ok ? std::ftell(file) : -1;
+    ok = size > 0 && std::fseek(file, 0, SEEK_SET) == 0;
+    if (ok) {
+        bytes.resize((size_t)size);
+        ok = std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    }
+    std::fclose(file);
+    return ok;
+}
+
+bool ImageSequenceSource::Read (Mat &frame) {
+    while (next < files.size()) {
+        if (!ReadFile(files[next++])) continue;
+        // Decoded straight into a free buffer when the image has the last one's size
+        frame = frameSize.area() > 0 ? pool.Acquire(frameSize, CV_8UC3) : Mat();
+        imdecode(bytes, IMREAD_COLOR, &frame);
+        if (!frame.empty()) {
+            frameSize = frame.size();
+            return true;
+        }
+    }
+    return false;
+}
+
+double ImageSequenceSource::Fps () {
+    return fps;
+}
+
+bool ImageSequenceSource::IsLive () {
+    return false;
+}
+
+bool ImageSequenceSource::IsEndless () {
+    return false;
+}
+
+size_t ImageSequenceSource::FileCount () {
+    return files.size();
+}
+
+
+// Test pattern
+SyntheticSource::SyntheticSource (Size size, long long frames, double fps)
+    : size(size), frames(frames), fps(fps) {
+    // Colour ramps with a grid, so filters and geometry have something to act on
+    background.create(size, CV_8UC3);
+    for (int y = 0; y < size.height; y++) {
+        Vec3b *row = background.ptr<Vec3b>(y);
+        for (int x = 0; x < size.width; x++) {
+            row[x] = Vec3b((uchar)(255*x / std::max(1, size.width - 1)),
+                           (uchar)(255*y / std::max(1, size.height - 1)),
+                           (uchar)(((x / 32) + (y / 32)) % 2 ? 200 : 60));
+        }
+    }
+}
+
+bool SyntheticSource::Read (Mat &frame) {
+    if (frames > 0 && index >= frames) {return false;}
+    frame = pool.Acquire(size, CV_8UC3);
+    background.copyTo(frame);
+    // A square bouncing between the edges, and the frame number
+    int side = std::max(8, size.height / 6),
+        spanX = std::max(1, size.width - side),
+        spanY = std::max(1, size.height - side),
+        x = (int)(index*7 % (2*spanX)),
+        y = (int)(index*5 % (2*spanY));
+    if (x > spanX) {x = 2*spanX - x;}
+    if (y > spanY) {y = 2*spanY - y;}
+    rectangle(frame, Rect(x, y, side, side), Scalar(255, 255, 255), FILLED);
+    putText(frame, std::to_string(index), Point(10, std::max(20, size.height / 12)),
+            FONT_HERSHEY_SIMPLEX, std::max(0.5, size.height / 480.0), Scalar(0, 0, 255), 2);
+    index++;
+    return true;
+}
+
+double SyntheticSource::Fps () {
+    return fps;
+}
+
+bool SyntheticSource::IsLive () {
+    return false;
+}
+
+bool SyntheticSource::IsEndless () {
+    return frames == 0;
+}
+
+
+// Decode-ahead wrapper
+PrefetchSource::PrefetchSource (std::unique_ptr<FrameSource> source, size_t frames)
+    : source(std::move(source)),
+      fps(this->source->Fps()),
+      live(this->source->IsLive()),
+      endless(this->source->IsEndless()),
+      decoded(frames, QueuePolicy::Block) {
+    decodeThread = std::thread(&PrefetchSource::DecodeLoop, this);
+}
+
+PrefetchSource::~PrefetchSource () {
+    decoded.Close();
+    if (decodeThread.joinable()) {decodeThread.join();}
+}
+
+void PrefetchSource::DecodeLoop () {
+    FrameTracer::NameThread("decoder");
+    Mat frame;
+    while (source->Read(frame)) {
+        if (!decoded.Push(std::move(frame))) break;  // Closed by the destructor
+    }
+    decoded.Close();
+}
+
+bool PrefetchSource::Read (Mat &frame) {
+    return decoded.Pop(frame);
+}
+
+double PrefetchSource::Fps () {
+    return fps;
+}
+
+bool PrefetchSource::IsLive () {
+    return live;
+}
+
+bool PrefetchSource::IsEndless () {
+    return endless;
+}
@@ -0,0 +1,141 @@
+#ifndef FRAMESOURCE_HPP
+#define FRAMESOURCE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FramePool.hpp"
+#include "FrameQueue.hpp"
+
+#define DEFAULT_PREFETCH_FRAMES 8   // Frames file-backed sources decode ahead
+#define SYNTHETIC_WIDTH 1280
+#define SYNTHETIC_HEIGHT 720
+
+// Where frames come from: a camera, a video file, a folder of images or a
+// generated test pattern.
+class FrameSource {
+    public:
+        virtual ~FrameSource() {}
+
+        // Next frame, false at the end or on a read error. The frame is
+        // the caller's to keep; its buffer goes back to the source's pool
+        // once every Mat referencing it is dropped.
+        virtual bool Read(cv::Mat &frame) = 0;
+
+        // Frames per second, 0 if unknown
+        virtual double Fps() = 0;
+
+        // Live sources (cameras) produce frames whether they are read or
+        // not, so old frames are better dropped than waited for
+        virtual bool IsLive() = 0;
+
+        // Never ends by itself (cameras, synthetic without FRAMES)
+        virtual bool IsEndless() = 0;
+
+        // A camera index ("0"), a video file, a folder of images, or
+        // "synthetic[:WIDTHxHEIGHT[:FRAMES]]" (an existing file or folder of
+        // that name comes first). Files and folders decode up to
+        // prefetchFrames ahead on a thread of their own (0: no prefetch).
+        // nullptr if the source can't be opened.
+        static std::unique_ptr<FrameSource> Open(const std::string &spec,
+                                                 size_t prefetchFrames = DEFAULT_PREFETCH_FRAMES);
+};
+
+// Camera or video file through cv::VideoCapture, read into pooled buffers
+class CaptureSource : public FrameSource {
+    protected:
+        cv::VideoCapture cap;
+        FramePool pool;
+        cv::Size frameSize;
+        int frameType = CV_8UC3;
+        bool live = false;
+
+    public:
+        bool Read(cv::Mat &frame) override;
+        double Fps() override;
+        bool IsLive() override;
+        bool IsEndless() override;
+        bool IsOpened();
+};
+
+class CameraSource : public CaptureSource {
+    public:
+        explicit CameraSource(int index);
+};
+
+class VideoFileSource : public CaptureSource {
+    public:
+        explicit VideoFileSource(const std::string &path);
+};
+
+// Every image of a folder, in file name order (unreadable files are skipped).
+// Files are read into one reused buffer and decoded into pooled frames.
+class ImageSequenceSource : public FrameSource {
+    private:
+        std::vector<std::string> files;
+        size_t next = 0;
+        double fps;
+        std::vector<uchar> bytes;
+        FramePool pool;
+        cv::Size frameSize;
+
+        bool ReadFile(const std::string &path);
+
+    public:
+        explicit ImageSequenceSource(const std::string &directory, double fps = 30);
+        bool Read(cv::Mat &frame) override;
+        double Fps() override;
+        bool IsLive() override;
+        bool IsEndless() override;
+        size_t FileCount();
+};
+
+// Deterministic moving pattern: frame i is always the same image, so runs
+// can be compared without a camera. Frames come as fast as they are read.
+class SyntheticSource : public FrameSource {
+    private:
+        cv::Size size;
+        long long frames;
+        double fps;
+        cv::Mat background;
+        FramePool pool;
+        long long index = 0;
+
+    public:
+        // frames: how many before the source ends (0: endless)
+        explicit SyntheticSource(cv::Size size = cv::Size(SYNTHETIC_WIDTH, SYNTHETIC_HEIGHT),
+                                 long long frames = 0, double fps = 30);
+        bool Read(cv::Mat &frame) override;
+        double Fps() override;
+        bool IsLive() override;
+        bool IsEndless() override;
+};
+
+// Reads another source ahead on a background thread, so decoding and
+// demuxing overlap with processing instead of delaying it. At most
+// `frames` decoded frames wait; the decoder then blocks until one is read.
+class PrefetchSource : public FrameSource {
+    private:
+        std::unique_ptr<FrameSource> source;
+        double fps;
+        bool live,
+             endless;
+        FrameQueue<cv::Mat> decoded;
+        std::thread decodeThread;
+
+        void DecodeLoop();
+
+    public:
+        PrefetchSource(std::unique_ptr<FrameSource> source, size_t frames = DEFAULT_PREFETCH_FRAMES);
+        ~PrefetchSource();
+
+        bool Read(cv::Mat &frame) override;
+        double Fps() override;
+        bool IsLive() override;
+        bool IsEndless() override;
+};
+
+#endif
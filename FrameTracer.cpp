@@ -0,0 +1,172 @@
+#include "FrameTracer.hpp"
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// One span per slot. A slot is rewritten once the ring wraps around, so
+// its sequence is odd while being written and Write() skips slots that
+// changed under it (a seqlock).
+struct FrameTracer::ThreadBuffer {
+    struct Slot {
+        std::atomic<uint64_t> sequence {0},
+                              startNs,
+                              durationNs,
+                              frame,
+                              name,
+                              filtersAndStream;
+    };
+
+    std::thread::id thread;
+    int tid;                            // Kernel thread ID, as perf and top show it
+    std::string name;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> next {0};     // Spans recorded so far
+};
+
+static std::atomic<uint64_t> lastTracerId {0};
+static thread_local FrameTracer::Context currentContext;
+static thread_local std::string threadName;
+
+static const char* const filterNames[TraceFilterCount] = {
+    "mirror", "rotation", "zoom out", "brightness/contrast", "greyscale", "negative",
+    "gaussian", "edges", "gradient", "incremental", "degraded", "proxy", "temporal", "auto exposure"
+};
+
+FrameTracer::FrameTracer (const std::string &path)
+    : path(path),
+      epoch(std::chrono::steady_clock::now()),
+      id(++lastTracerId) {
+}
+
+FrameTracer::~FrameTracer () {
+}
+
+// This thread's buffer, registered on its first span
+FrameTracer::ThreadBuffer* FrameTracer::LocalBuffer () {
+    static thread_local uint64_t cachedTracerId = 0;
+    static thread_local ThreadBuffer *cachedBuffer = nullptr;
+    if (cachedTracerId == id) {return cachedBuffer;}
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    std::thread::id self = std::this_thread::get_id();
+    ThreadBuffer *buffer = nullptr;
+    for (std::unique_ptr<ThreadBuffer> &existing : buffers) {
+        if (existing->thread == self) {buffer = existing.get();}
+    }
+    if (!buffer) {
+        buffers.emplace_back(new ThreadBuffer());
+        buffer = buffers.back().get();
+        buffer->thread = self;
+        buffer->tid = (int)syscall(SYS_gettid);
+        buffer->name = threadName;
+        buffer->slots.reset(new ThreadBuffer::Slot[TRACE_BUFFER_SPANS]);
+    }
+    cachedTracerId = id;
+    cachedBuffer = buffer;
+    return buffer;
+}
+
+void FrameTracer::Record (const char *name, std::chrono::steady_clock::time_point start,
+                          std::chrono::steady_clock::time_point end) {
+    ThreadBuffer *buffer = LocalBuffer();
+    uint64_t n = buffer->next.load(std::memory_order_relaxed);
+    ThreadBuffer::Slot &slot = buffer->slots[n % TRACE_BUFFER_SPANS];
+    slot.sequence.store(2*n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.startNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count(), std::memory_order_relaxed);
+    slot.durationNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), std::memory_order_relaxed);
+    slot.frame.store((uint64_t)currentContext.frame, std::memory_order_relaxed);
+    slot.name.store((uint64_t)(uintptr_t)name, std::memory_order_relaxed);
+    slot.filtersAndStream.store(currentContext.filters | (uint64_t)(uint32_t)currentContext.stream << 32, std::memory_order_relaxed);
+    slot.sequence.store(2*n + 2, std::memory_order_release);
+    buffer->next.store(n + 1, std::memory_order_release);
+}
+
+
+// Chrome trace-event format: one complete ("X") event per span, timestamps
+// in microseconds, plus a metadata event naming each thread
+bool FrameTracer::Write () {
+    return Write(path);
+}
+
+bool FrameTracer::Write (const std::string &path) {
+    std::ofstream out(path);
+    if (!out) {return false;}
+    int pid = (int)getpid();
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << std::fixed << std::setprecision(3);
+    bool first = true;
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    for (std::unique_ptr<ThreadBuffer> &buffer : buffers) {
+        if (!buffer->name.empty()) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+                << ",\"tid\":" << buffer->tid << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+            first = false;
+        }
+
+        uint64_t count = buffer->next.load(std::memory_order_acquire),
+                 oldest = count > TRACE_BUFFER_SPANS ? count - TRACE_BUFFER_SPANS : 0;
+        for (uint64_t n = oldest; n < count; n++) {
+            ThreadBuffer::Slot &slot = buffer->slots[n % TRACE_BUFFER_SPANS];
+            uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence != 2*n + 2) continue;      // Already overwritten
+            int64_t startNs = (int64_t)slot.startNs.load(std::memory_order_relaxed),
+                    durationNs = (int64_t)slot.durationNs.load(std::memory_order_relaxed),
+                    frame = (int64_t)slot.frame.load(std::memory_order_relaxed);
+            const char *name = (const char*)(uintptr_t)slot.name.load(std::memory_order_relaxed);
+            uint64_t filtersAndStream = slot.filtersAndStream.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+
+            int stream = (int)(uint32_t)(filtersAndStream >> 32);
+            out << (first ? "" : ",\n") << "{\"name\":\"" << name << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":" << pid
+                << ",\"tid\":" << buffer->tid << ",\"ts\":" << startNs / 1000.0 << ",\"dur\":" << durationNs / 1000.0
+                << ",\"args\":{\"frame\":" << frame;
+            if (stream >= 0) {out << ",\"stream\":" << stream;}
+            out << ",\"filters\":\"" << FilterNames((uint32_t)filtersAndStream) << "\"}}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
+
+const std::string& FrameTracer::Path () {
+    return path;
+}
+
+
+// Per-thread context
+void FrameTracer::SetContext (const Context &context) {
+    currentContext = context;
+}
+
+void FrameTracer::SetFrame (long long frame) {
+    currentContext.frame = frame;
+}
+
+void FrameTracer::SetFilters (uint32_t filters) {
+    currentContext.filters = filters;
+}
+
+FrameTracer::Context FrameTracer::CurrentContext () {
+    return currentContext;
+}
+
+// Shown by the trace viewer; takes effect for tracers this thread hasn't recorded to yet
+void FrameTracer::NameThread (const std::string &name) {
+    threadName = name;
+}
+
+std::string FrameTracer::FilterNames (uint32_t filters) {
+    std::string names;
+    for (int i = 0; i < (int)TraceFilterCount; i++) {
+        if (filters & (1u << i)) {
+            if (!names.empty()) {names += ", ";}
+            names += filterNames[i];
+        }
+    }
+    return names;
+}
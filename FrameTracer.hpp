@@ -0,0 +1,97 @@
+#ifndef FRAMETRACER_HPP
+#define FRAMETRACER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define TRACE_BUFFER_SPANS 32768    // Newest spans kept per thread (about 100 s of a 30 fps pipeline)
+
+// Filters active on the frame a span belongs to
+enum TraceFilter : uint32_t {
+    TraceMirror         = 1 << 0,
+    TraceRotation       = 1 << 1,
+    TraceZoomOut        = 1 << 2,
+    TraceBrightContrast = 1 << 3,
+    TraceGreyscale      = 1 << 4,
+    TraceNegative       = 1 << 5,
+    TraceGaussian       = 1 << 6,
+    TraceEdges          = 1 << 7,
+    TraceGradient       = 1 << 8,
+    TraceIncremental    = 1 << 9,
+    TraceDegraded       = 1 << 10,  // Preview below full quality
+    TraceProxy          = 1 << 11,  // Preview filtered at a lower resolution
+    TraceTemporal       = 1 << 12,
+    TraceAutoExposure   = 1 << 13,
+    TraceFilterCount    = 14
+};
+
+// Timeline of every stage each frame went through, on every thread, saved
+// as Chrome trace-event JSON (open it in ui.perfetto.dev or chrome://tracing).
+// Each thread appends to a ring buffer of its own without locking; only its
+// first span takes a lock, to register the buffer. Spans carry the frame
+// number, stream and filters the thread was last given with SetContext().
+class FrameTracer {
+    private:
+        struct ThreadBuffer;
+
+        std::string path;
+        std::chrono::steady_clock::time_point epoch;
+        uint64_t id;                    // Tells thread-local caches apart from a previous tracer's
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::mutex buffersMutex;
+
+        ThreadBuffer* LocalBuffer();
+
+    public:
+        // What the spans a thread records belong to
+        struct Context {
+            long long frame = -1;
+            uint32_t filters = 0;
+            int stream = -1;            // Multi-stream only
+        };
+
+        // path: where Write() saves
+        explicit FrameTracer(const std::string &path);
+        ~FrameTracer();
+
+        void Record(const char *name, std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end);
+
+        // Saves the spans kept so far (while recording goes on); false if the file couldn't be written
+        bool Write();
+        bool Write(const std::string &path);
+        const std::string& Path();
+
+        // Per thread, shared by every tracer
+        static void SetContext(const Context &context);
+        static void SetFrame(long long frame);
+        static void SetFilters(uint32_t filters);
+        static Context CurrentContext();
+        static void NameThread(const std::string &name);
+        static std::string FilterNames(uint32_t filters);
+};
+
+// Traces the enclosing scope as one span; does nothing without a tracer
+class TraceScope {
+    private:
+        FrameTracer *tracer;
+        const char *name;               // Must outlive the tracer (a literal)
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        TraceScope (FrameTracer *tracer, const char *name)
+            : tracer(tracer), name(name) {
+            if (tracer) {start = std::chrono::steady_clock::now();}
+        }
+
+        ~TraceScope () {
+            if (tracer) {tracer->Record(name, start, std::chrono::steady_clock::now());}
+        }
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "GeometryTransform.hpp"
+#include <opencv2/core.hpp>
+using namespace cv;
+
+#define GEOMETRY_TILE 32    // Output tile side, keeps rotated reads in cache
+
+// Source box of an output pixel: (u0 + ux*x + uy*y, v0 + vx*x + vy*y) in
+// downscaled coordinates
+struct Mapping {
+    int u0, ux, uy,
+        v0, vx, vy;
+};
+
+template <int CN>
+static void TransformTiles (const Mat &src, Mat &dst, const Mapping &m, int levels, const Range &tileRows) {
+    int factor = 1 << levels,
+        half = (factor*factor) >> 1,
+        shift = levels*2;
+    for (int ty = tileRows.start; ty < tileRows.end; ty++) {
+        int yEnd = std::min((ty + 1)*GEOMETRY_TILE, dst.rows);
+        for (int tx = 0; tx < dst.cols; tx += GEOMETRY_TILE) {
+            int xEnd = std::min(tx + GEOMETRY_TILE, dst.cols);
+            for (int y = ty*GEOMETRY_TILE; y < yEnd; y++) {
+                uchar *out = dst.ptr<uchar>(y) + tx*CN;
+                for (int x = tx; x < xEnd; x++, out += CN) {
+                    int sx = (m.u0 + m.ux*x + m.uy*y) * factor,
+                        sy = (m.v0 + m.vx*x + m.vy*y) * factor;
+                    if (levels == 0) {
+                        const uchar *in = src.ptr<uchar>(sy) + sx*CN;
+                        for (int c = 0; c < CN; c++) {out[c] = in[c];}
+                        continue;
+                    }
+                    int sum[CN] = {0};
+                    for (int by = 0; by < factor; by++) {
+                        const uchar *in = src.ptr<uchar>(sy + by) + sx*CN;
+                        for (int bx = 0; bx < factor*CN; bx += CN) {
+                            for (int c = 0; c < CN; c++) {sum[c] += in[bx + c];}
+                        }
+                    }
+                    for (int c = 0; c < CN; c++) {out[c] = (uchar)((sum[c] + half) >> shift);}
+                }
+            }
+        }
+    }
+}
+
+
+int GeometryTransform::ReachableZoomLevels (Size size, int zoomOut, bool &maxZoomReached) {
+    int levels = 0;
+    maxZoomReached = false;
+    for (int i = 0; i < zoomOut; i++) {
+        size = Size(size.width/2, size.height/2);
+        levels++;
+        if (size.height/2 == 0 || size.width/2 == 0) {
+            maxZoomReached = true;
+            break;
+        }
+    }
+    return levels;
+}
+
+bool GeometryTransform::IsIdentity () const {
+    return !mirrorH && !mirrorV && rotation == 0 && zoomLevels == 0;
+}
+
+Size GeometryTransform::OutputSize (Size input) const {
+    Size small(input.width >> zoomLevels, input.height >> zoomLevels);
+    if (rotation == 90 || rotation == 270) {return Size(small.height, small.width);}
+    return small;
+}
+
+void GeometryTransform::Apply (const Mat &src, Mat &dst) const {
+    if (IsIdentity()) {
+        dst = src;
+        return;
+    }
+    CV_Assert(src.depth() == CV_8U && (src.channels() == 1 || src.channels() == 3));
+
+    int w = src.cols >> zoomLevels,
+        h = src.rows >> zoomLevels;
+
+    // Rotation first (output -> unrotated coordinates)...
+    Mapping m;
+    switch (rotation) {
+    case 90:
+        m = {0, 0, 1,  h - 1, -1, 0};
+        break;
+    case 180:
+        m = {w - 1, -1, 0,  h - 1, 0, -1};
+        break;
+    case 270:
+        m = {w - 1, 0, -1,  0, 1, 0};
+        break;
+    default:
+        m = {0, 1, 0,  0, 0, 1};
+        break;
+    }
+    // ...then the mirrors, which were applied to the source before rotating
+    if (mirrorH) {m.u0 = w - 1 - m.u0; m.ux = -m.ux; m.uy = -m.uy;}
+    if (mirrorV) {m.v0 = h - 1 - m.v0; m.vx = -m.vx; m.vy = -m.vy;}
+
+    // Reuses dst if it already has the right shape (never in place)
+    if (dst.data == src.data) {dst.release();}
+    dst.create(OutputSize(src.size()), src.type());
+    int tileRows = (dst.rows + GEOMETRY_TILE - 1) / GEOMETRY_TILE;
+    int levels = zoomLevels;
+    parallel_for_(Range(0, tileRows), [&](const Range &range) {
+        if (src.channels() == 3) {
+            TransformTiles<3>(src, dst, m, levels, range);
+        } else {
+            TransformTiles<1>(src, dst, m, levels, range);
+        }
+    });
+}
@@ -0,0 +1,28 @@
+#ifndef GEOMETRYTRANSFORM_HPP
+#define GEOMETRYTRANSFORM_HPP
+
+#include <opencv2/core.hpp>
+
+// Mirror, 90 degree rotation and power-of-two zoom out done as one
+// cache-blocked pass: every output pixel averages its box of source pixels,
+// so the source is read only once whatever the zoom level.
+class GeometryTransform {
+    public:
+        bool mirrorH = false,
+             mirrorV = false;
+        int rotation = 0,       // Clockwise: 0, 90, 180 or 270
+            zoomLevels = 0;     // Output is 2^zoomLevels times smaller
+
+        // How many of the requested halvings still leave a visible image
+        // (same stopping rule the zoom buttons always used)
+        static int ReachableZoomLevels(cv::Size size, int zoomOut, bool &maxZoomReached);
+
+        bool IsIdentity() const;
+        cv::Size OutputSize(cv::Size input) const;
+
+        // Writes into dst, reusing its buffer when the shape matches;
+        // dst is src itself if nothing changes
+        void Apply(const cv::Mat &src, cv::Mat &dst) const;
+};
+
+#endif
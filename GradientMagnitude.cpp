@@ -0,0 +1,192 @@
+#include "GradientMagnitude.hpp"
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+using namespace cv;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GRADIENT_X86 1
+#include <immintrin.h>
+#endif
+
+// Sobel's 3x3 kernels, per channel:
+//   Gx = (r0 + 2*r1 + r2)[x+1] - (r0 + 2*r1 + r2)[x-1]
+//   Gy = (r2 - r0)[x-1] + 2*(r2 - r0)[x] + (r2 - r0)[x+1]
+// then min(|Gx|, 255) and min(|Gy|, 255) averaged with addWeighted's
+// rounding (to nearest, ties to even).
+static inline uchar Combine (int gx, int gy) {
+    int sum = std::min(std::abs(gx), 255) + std::min(std::abs(gy), 255);
+    int half = sum >> 1;
+    return (uchar)(half + (sum & half & 1));
+}
+
+static inline uchar GradientAt (const uchar *r0, const uchar *r1, const uchar *r2, int left, int center, int right) {
+    int gx = (r0[right] + 2*r1[right] + r2[right]) - (r0[left] + 2*r1[left] + r2[left]);
+    int gy = (r2[left] - r0[left]) + 2*(r2[center] - r0[center]) + (r2[right] - r0[right]);
+    return Combine(gx, gy);
+}
+
+// Elements [start, end) of a row whose neighbours are all inside the row
+static int ScalarRange (const uchar *r0, const uchar *r1, const uchar *r2, uchar *out, int cn, int start, int end) {
+    for (int i = start; i < end; i++) {
+        out[i] = GradientAt(r0, r1, r2, i - cn, i, i + cn);
+    }
+    return end;
+}
+
+#ifdef GRADIENT_X86
+// Also built on i386, where SSE2 isn't part of the baseline: every SSE2
+// function says so itself, like the AVX2 ones, and is only called when
+// the CPU has it
+__attribute__((target("sse2")))
+static inline __m128i Sse2Load (const uchar *p) {
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+}
+
+__attribute__((target("sse2")))
+static inline __m128i Sse2AbsClamp (__m128i v) {
+    return _mm_min_epi16(_mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v)), _mm_set1_epi16(255));
+}
+
+__attribute__((target("sse2")))
+static int Sse2Range (const uchar *r0, const uchar *r1, const uchar *r2, uchar *out, int cn, int start, int end) {
+    const __m128i one = _mm_set1_epi16(1);
+
+    int i = start;
+    for (; i + 8 <= end; i += 8) {
+        __m128i a0 = Sse2Load(r0 + i - cn), a1 = Sse2Load(r1 + i - cn), a2 = Sse2Load(r2 + i - cn),
+                b0 = Sse2Load(r0 + i),                                  b2 = Sse2Load(r2 + i),
+                c0 = Sse2Load(r0 + i + cn), c1 = Sse2Load(r1 + i + cn), c2 = Sse2Load(r2 + i + cn);
+        __m128i left = _mm_add_epi16(_mm_add_epi16(a0, a2), _mm_add_epi16(a1, a1)),
+                right = _mm_add_epi16(_mm_add_epi16(c0, c2), _mm_add_epi16(c1, c1));
+        __m128i gx = _mm_sub_epi16(right, left);
+        __m128i center = _mm_sub_epi16(b2, b0);
+        __m128i gy = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(a2, a0), _mm_sub_epi16(c2, c0)),
+                                   _mm_add_epi16(center, center));
+        __m128i sum = _mm_add_epi16(Sse2AbsClamp(gx), Sse2AbsClamp(gy));
+        __m128i half = _mm_srli_epi16(sum, 1);
+        __m128i result = _mm_add_epi16(half, _mm_and_si128(_mm_and_si128(sum, half), one));
+        _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(result, result));
+    }
+    return i;
+}
+
+// Built for AVX2 whatever the compiler flags; only called if the CPU has it
+__attribute__((target("avx2")))
+static inline __m256i Avx2Load (const uchar *p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+}
+
+__attribute__((target("avx2")))
+static int Avx2Range (const uchar *r0, const uchar *r1, const uchar *r2, uchar *out, int cn, int start, int end) {
+    const __m256i max = _mm256_set1_epi16(255),
+                  one = _mm256_set1_epi16(1);
+
+    int i = start;
+    for (; i + 16 <= end; i += 16) {
+        __m256i a0 = Avx2Load(r0 + i - cn), a1 = Avx2Load(r1 + i - cn), a2 = Avx2Load(r2 + i - cn),
+                b0 = Avx2Load(r0 + i),                                  b2 = Avx2Load(r2 + i),
+                c0 = Avx2Load(r0 + i + cn), c1 = Avx2Load(r1 + i + cn), c2 = Avx2Load(r2 + i + cn);
+        __m256i left = _mm256_add_epi16(_mm256_add_epi16(a0, a2), _mm256_add_epi16(a1, a1)),
+                right = _mm256_add_epi16(_mm256_add_epi16(c0, c2), _mm256_add_epi16(c1, c1));
+        __m256i gx = _mm256_sub_epi16(right, left);
+        __m256i center = _mm256_sub_epi16(b2, b0);
+        __m256i gy = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(a2, a0), _mm256_sub_epi16(c2, c0)),
+                                      _mm256_add_epi16(center, center));
+        __m256i sum = _mm256_add_epi16(_mm256_min_epi16(_mm256_abs_epi16(gx), max),
+                                       _mm256_min_epi16(_mm256_abs_epi16(gy), max));
+        __m256i half = _mm256_srli_epi16(sum, 1);
+        __m256i result = _mm256_add_epi16(half, _mm256_and_si256(_mm256_and_si256(sum, half), one));
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(result), _mm256_extracti128_si256(result, 1));
+        _mm_storeu_si128((__m128i*)(out + i), packed);
+    }
+    return i;
+}
+#endif
+
+typedef int (*RangeKernel)(const uchar*, const uchar*, const uchar*, uchar*, int, int, int);
+
+static RangeKernel KernelFor (GradientBackend backend) {
+#ifdef GRADIENT_X86
+    if (backend == GradientBackend::AVX2) {return Avx2Range;}
+    if (backend == GradientBackend::SSE2) {return Sse2Range;}
+#endif
+    return ScalarRange;
+}
+
+// BORDER_REFLECT_101, as Sobel's default border
+static inline int Reflect101 (int i, int size) {
+    if (size == 1) {return 0;}
+    if (i < 0) {return -i;}
+    if (i >= size) {return 2*size - i - 2;}
+    return i;
+}
+
+
+GradientBackend GradientMagnitude::DefaultBackend () {
+    if (IsSupported(GradientBackend::AVX2)) {return GradientBackend::AVX2;}
+    if (IsSupported(GradientBackend::SSE2)) {return GradientBackend::SSE2;}
+    return GradientBackend::Scalar;
+}
+
+bool GradientMagnitude::IsSupported (GradientBackend backend) {
+    switch (backend) {
+#ifdef GRADIENT_X86
+    case GradientBackend::AVX2: return __builtin_cpu_supports("avx2");
+    case GradientBackend::SSE2: return __builtin_cpu_supports("sse2");
+#else
+    case GradientBackend::AVX2: return false;
+    case GradientBackend::SSE2: return false;
+#endif
+    default:                    return true;
+    }
+}
+
+const char* GradientMagnitude::BackendName (GradientBackend backend) {
+    switch (backend) {
+    case GradientBackend::OpenCV:   return "opencv";
+    case GradientBackend::Scalar:   return "scalar";
+    case GradientBackend::SSE2:     return "sse2";
+    case GradientBackend::AVX2:     return "avx2";
+    default:                        return "?";
+    }
+}
+
+void GradientMagnitude::Apply (const Mat &src, Mat &dst, GradientBackend backend) {
+    if (backend == GradientBackend::OpenCV || src.depth() != CV_8U || !IsSupported(backend)) {
+        Mat gradX, gradY, absX, absY;
+        Sobel(src, gradX, CV_16S, 1, 0, 3);
+        Sobel(src, gradY, CV_16S, 0, 1, 3);
+        convertScaleAbs(gradX, absX);
+        convertScaleAbs(gradY, absY);
+        addWeighted(absX, 0.5, absY, 0.5, 0, dst);
+        return;
+    }
+
+    dst.create(src.size(), src.type());
+    RangeKernel kernel = KernelFor(backend);
+    int cn = src.channels(),
+        cols = src.cols,
+        width = cols*cn;
+
+    parallel_for_(Range(0, src.rows), [&](const Range &range) {
+        for (int y = range.start; y < range.end; y++) {
+            const uchar *r0 = src.ptr<uchar>(Reflect101(y - 1, src.rows)),
+                        *r1 = src.ptr<uchar>(y),
+                        *r2 = src.ptr<uchar>(Reflect101(y + 1, src.rows));
+            uchar *out = dst.ptr<uchar>(y);
+
+            // First and last columns reflect; everything in between has both neighbours
+            for (int x = 0; x < cols; x += std::max(cols - 1, 1)) {
+                int left = Reflect101(x - 1, cols)*cn,
+                    right = Reflect101(x + 1, cols)*cn;
+                for (int c = 0; c < cn; c++) {
+                    out[x*cn + c] = GradientAt(r0, r1, r2, left + c, x*cn + c, right + c);
+                }
+            }
+            if (cols > 2) {
+                int done = kernel(r0, r1, r2, out, cn, cn, width - cn);
+                ScalarRange(r0, r1, r2, out, cn, done, width - cn);
+            }
+        }
+    });
+}
@@ -0,0 +1,28 @@
+#ifndef GRADIENTMAGNITUDE_HPP
+#define GRADIENTMAGNITUDE_HPP
+
+#include <opencv2/core.hpp>
+
+// Ways of computing the gradient filter
+enum class GradientBackend {
+    OpenCV,     // Sobel x2, convertScaleAbs x2 and addWeighted
+    Scalar,     // Fused kernel, plain C++
+    SSE2,       // Fused kernel, 8 values per step
+    AVX2        // Fused kernel, 16 values per step
+};
+
+// |Sobel x|/2 + |Sobel y|/2 of an 8-bit image in one pass: each output row
+// is computed straight from its three source rows, with no 16-bit
+// intermediate images. Output is identical to the OpenCV chain.
+class GradientMagnitude {
+    public:
+        // Fastest backend this CPU can run
+        static GradientBackend DefaultBackend();
+        static bool IsSupported(GradientBackend backend);
+        static const char* BackendName(GradientBackend backend);
+
+        // src and dst must be different buffers; dst is reused if its shape matches
+        static void Apply(const cv::Mat &src, cv::Mat &dst, GradientBackend backend);
+};
+
+#endif
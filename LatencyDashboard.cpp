@@ -0,0 +1,123 @@
+#include "LatencyDashboard.hpp"
+#include <QPainter>
+#include <QStringList>
+#include <QTimer>
+#include <QVBoxLayout>
+#include <QtCharts/QBarCategoryAxis>
+#include <QtCharts/QChart>
+#include <QtCharts/QChartView>
+#include <QtCharts/QHorizontalBarSeries>
+#include <algorithm>
+using namespace QtCharts;
+
+#define DASHBOARD_WIDTH 520
+#define DASHBOARD_HEIGHT 585
+#define REFRESH_MS 250
+#define TRACE_SECONDS 30
+
+LatencyDashboard::LatencyDashboard (StageProfiler &profiler, double frameBudget, QWidget *parent)
+    : QWidget(parent), profiler(profiler), frameBudget(frameBudget) {
+    setWindowTitle("Latency");
+    resize(DASHBOARD_WIDTH, DASHBOARD_HEIGHT);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    // 1. Percentiles of every stage
+    p50Set = new QBarSet("p50");
+    p95Set = new QBarSet("p95");
+    p99Set = new QBarSet("p99");
+    maxSet = new QBarSet("max");
+    QStringList stages;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stages << StageProfiler::StageName((Stage)i);
+        *p50Set << 0;
+        *p95Set << 0;
+        *p99Set << 0;
+        *maxSet << 0;
+    }
+    QHorizontalBarSeries *bars = new QHorizontalBarSeries();
+    bars->append(p50Set);
+    bars->append(p95Set);
+    bars->append(p99Set);
+    bars->append(maxSet);
+
+    QChart *stageChart = new QChart();
+    stageChart->setTitle("Stage latency (ms)");
+    stageChart->addSeries(bars);
+    QBarCategoryAxis *namesAxis = new QBarCategoryAxis();
+    namesAxis->append(stages);
+    stageChart->addAxis(namesAxis, Qt::AlignLeft);
+    bars->attachAxis(namesAxis);
+    stageAxis = new QValueAxis();
+    stageAxis->setRange(0, frameBudget);
+    stageChart->addAxis(stageAxis, Qt::AlignBottom);
+    bars->attachAxis(stageAxis);
+
+    QChartView *stageView = new QChartView(stageChart);
+    stageView->setRenderHint(QPainter::Antialiasing);
+    layout->addWidget(stageView, 3);
+
+    // 2. End-to-end latency and FPS over time
+    latencySeries = new QLineSeries();
+    latencySeries->setName("End to end p50 (ms)");
+    fpsSeries = new QLineSeries();
+    fpsSeries->setName("FPS");
+
+    QChart *traceChart = new QChart();
+    traceChart->addSeries(latencySeries);
+    traceChart->addSeries(fpsSeries);
+    timeAxis = new QValueAxis();
+    timeAxis->setTitleText("s");
+    timeAxis->setRange(0, TRACE_SECONDS);
+    traceChart->addAxis(timeAxis, Qt::AlignBottom);
+    latencySeries->attachAxis(timeAxis);
+    fpsSeries->attachAxis(timeAxis);
+    latencyAxis = new QValueAxis();
+    latencyAxis->setRange(0, frameBudget*2);
+    traceChart->addAxis(latencyAxis, Qt::AlignLeft);
+    latencySeries->attachAxis(latencyAxis);
+    fpsAxis = new QValueAxis();
+    fpsAxis->setRange(0, 2000/frameBudget);
+    traceChart->addAxis(fpsAxis, Qt::AlignRight);
+    fpsSeries->attachAxis(fpsAxis);
+
+    QChartView *traceView = new QChartView(traceChart);
+    traceView->setRenderHint(QPainter::Antialiasing);
+    layout->addWidget(traceView, 2);
+
+    // 3. Refresh periodically (driven by the processEvents loop)
+    clock.start();
+    QTimer *timer = new QTimer(this);
+    QObject::connect(timer, &QTimer::timeout, this, [this]() {
+        Refresh();
+    });
+    timer->start(REFRESH_MS);
+}
+
+void LatencyDashboard::Refresh () {
+    double longest = frameBudget;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        StageSummary summary = profiler.Summary((Stage)i);
+        p50Set->replace(i, summary.p50);
+        p95Set->replace(i, summary.p95);
+        p99Set->replace(i, summary.p99);
+        maxSet->replace(i, summary.max);
+        longest = std::max(longest, summary.max);
+    }
+    stageAxis->setRange(0, longest*1.1);
+
+    // Each displayed frame adds one end-to-end sample
+    double now = clock.elapsed() / 1000.0;
+    StageSummary endToEnd = profiler.Summary(Stage::EndToEnd);
+    double fps = now > lastTime ? (endToEnd.count - lastFrames) / (now - lastTime) : 0;
+    lastFrames = endToEnd.count;
+    lastTime = now;
+
+    latencySeries->append(now, endToEnd.p50);
+    fpsSeries->append(now, fps);
+    while (latencySeries->count() > 0 && latencySeries->at(0).x() < now - TRACE_SECONDS) {
+        latencySeries->remove(0);
+        fpsSeries->remove(0);
+    }
+    timeAxis->setRange(std::max(0.0, now - TRACE_SECONDS), std::max((double)TRACE_SECONDS, now));
+    latencyAxis->setRange(0, std::max(frameBudget*2, endToEnd.max*1.1));
+}
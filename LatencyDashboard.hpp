@@ -0,0 +1,39 @@
+#ifndef LATENCYDASHBOARD_HPP
+#define LATENCYDASHBOARD_HPP
+
+#include <QElapsedTimer>
+#include <QWidget>
+#include <QtCharts/QBarSet>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QValueAxis>
+#include "StageProfiler.hpp"
+
+// Live charts of a StageProfiler: p50/p95/p99/max of every stage,
+// plus a trace of end-to-end latency and display FPS.
+class LatencyDashboard : public QWidget {
+    private:
+        StageProfiler &profiler;
+        double frameBudget;     // Milliseconds available per frame
+
+        QtCharts::QBarSet *p50Set,
+                          *p95Set,
+                          *p99Set,
+                          *maxSet;
+        QtCharts::QValueAxis *stageAxis,
+                             *timeAxis,
+                             *latencyAxis,
+                             *fpsAxis;
+        QtCharts::QLineSeries *latencySeries,
+                              *fpsSeries;
+
+        QElapsedTimer clock;
+        long long lastFrames = 0;
+        double lastTime = 0;
+
+        void Refresh();
+
+    public:
+        LatencyDashboard(StageProfiler &profiler, double frameBudget, QWidget *parent = nullptr);
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "MultiStreamPipeline.hpp"
+#include <algorithm>
+#include <iostream>
+using namespace cv;
+
+#define DEFAULT_FPS 30      // Recording rate when the source doesn't tell
+
+StreamConfig::StreamConfig () {
+    // Many recorders share the machine: one encoder each, never blocking the pool
+    recorder.encoderThreads = 1;
+    recorder.dropWhenFull = true;
+}
+
+struct MultiStreamPipeline::Stream {
+    size_t index;
+    StreamConfig config;
+    bool external;                  // Fed by Submit()
+    double fps = DEFAULT_FPS;
+    std::unique_ptr<FrameSource> source;
+    VideoManager manager;
+    AsyncRecorder recorder;
+    StageProfiler profiler;
+    FrameQueue<FramePacket> queue;
+    std::thread captureThread;
+    std::atomic<bool> captureDone {false};
+    std::atomic<long long> captured {0},
+                           processed {0};
+    bool recordFailed = false;      // Only touched by the stream's own tasks
+
+    // Scheduling state (scheduleMutex)
+    bool busy = false;
+    double virtualMs = 0;           // Processing time used, divided by the weight
+
+    Stream (size_t index, const StreamConfig &config, std::unique_ptr<FrameSource> source, QueuePolicy policy)
+        : index(index), config(config), external(!source), source(std::move(source)),
+          recorder(config.recorder), queue(config.queueCapacity, policy) {}
+};
+
+MultiStreamPipeline::MultiStreamPipeline (WorkStealingPool &pool)
+    : pool(pool) {
+}
+
+MultiStreamPipeline::~MultiStreamPipeline () {
+    Stop();
+}
+
+int MultiStreamPipeline::AddStream (const StreamConfig &config) {
+    if (started) {return -1;}
+    std::unique_ptr<FrameSource> source;
+    if (!config.source.empty()) {
+        source = FrameSource::Open(config.source);
+        if (!source) {return -1;}
+    }
+    QueuePolicy policy = source && source->IsLive() ? QueuePolicy::DropOldest : QueuePolicy::Block;
+    std::unique_ptr<Stream> stream(new Stream(streams.size(), config, std::move(source), policy));
+    if (stream->source && stream->source->Fps() > 0) {stream->fps = stream->source->Fps();}
+    config.spec.ApplyTo(stream->manager);
+    if (config.incremental) {stream->manager.SetIncrementalMode(true, config.incrementalTolerance);}
+    stream->manager.SetProfiler(&stream->profiler);
+    stream->recorder.SetProfiler(&stream->profiler);
+    streams.push_back(std::move(stream));
+    return (int)streams.size() - 1;
+}
+
+void MultiStreamPipeline::SetFrameCallback (std::function<void(size_t, const FramePacket&)> callback) {
+    onFrame = callback;
+}
+
+void MultiStreamPipeline::SetTracer (FrameTracer *tracer) {
+    for (std::unique_ptr<Stream> &stream : streams) {stream->profiler.SetTracer(tracer);}
+}
+
+VideoManager& MultiStreamPipeline::Manager (size_t stream) {
+    return streams[stream]->manager;
+}
+
+size_t MultiStreamPipeline::StreamCount () {
+    return streams.size();
+}
+
+
+// Start or stop every stream
+void MultiStreamPipeline::Start () {
+    if (started) {return;}
+    started = true;
+    startTime = std::chrono::steady_clock::now();
+    for (std::unique_ptr<Stream> &stream : streams) {
+        // With fewer streams than cores, frames are also split into strips
+        if (streams.size() < pool.Size()) {stream->manager.SetStripExecution(&pool);}
+        if (!stream->external) {stream->captureThread = std::thread(&MultiStreamPipeline::CaptureLoop, this, stream.get());}
+    }
+}
+
+void MultiStreamPipeline::Stop () {
+    if (!started) {return;}
+    started = false;
+    for (std::unique_ptr<Stream> &stream : streams) {stream->queue.Close();}
+    for (std::unique_ptr<Stream> &stream : streams) {
+        if (stream->captureThread.joinable()) {stream->captureThread.join();}
+    }
+    WaitIdle();
+    for (std::unique_ptr<Stream> &stream : streams) {stream->recorder.Stop();}
+    for (std::unique_ptr<Stream> &stream : streams) {stream->recorder.WaitForFlush();}
+}
+
+
+// Capture side: one thread per source
+void MultiStreamPipeline::CaptureLoop (Stream *stream) {
+    FrameTracer::NameThread("capture " + std::to_string(stream->index));
+    FrameTracer::Context context;
+    context.stream = (int)stream->index;
+    while (started) {
+        FramePacket packet;
+        bool read;
+        context.frame = stream->captured;
+        FrameTracer::SetContext(context);
+        {
+            StageTimer timer(&stream->profiler, Stage::Capture);
+            read = stream->source->Read(packet.original);
+        }
+        packet.captureTime = std::chrono::steady_clock::now();
+        if (!read) break;
+        packet.index = stream->captured++;
+        if (!stream->queue.Push(std::move(packet))) break;
+        Dispatch();
+    }
+    stream->captureDone = true;
+}
+
+bool MultiStreamPipeline::Submit (size_t stream, const Mat &frame, std::chrono::steady_clock::time_point captureTime) {
+    Stream *target = streams[stream].get();
+    if (!started || !target->external) {return false;}
+    FramePacket packet;
+    packet.original = frame;
+    packet.captureTime = captureTime;
+    packet.index = target->captured++;
+    bool queued = target->queue.Push(std::move(packet));
+    Dispatch();
+    return queued;
+}
+
+
+// Scheduling
+void MultiStreamPipeline::Dispatch () {
+    std::lock_guard<std::mutex> lock(scheduleMutex);
+    DispatchLocked();
+}
+
+void MultiStreamPipeline::DispatchLocked () {
+    while (running < pool.Size()) {
+        // Least served stream first, among those with a frame waiting
+        std::vector<Stream*> candidates;
+        for (std::unique_ptr<Stream> &stream : streams) {
+            if (!stream->busy) {candidates.push_back(stream.get());}
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Stream *a, const Stream *b) {
+            return a->virtualMs < b->virtualMs;
+        });
+        Stream *chosen = nullptr;
+        FramePacket packet;
+        for (Stream *stream : candidates) {
+            if (stream->queue.TryPop(packet)) {
+                chosen = stream;
+                break;
+            }
+        }
+        if (!chosen) break;
+
+        // A stream that sat idle does not get to catch up on the time it didn't use
+        chosen->virtualMs = std::max(chosen->virtualMs, virtualClock);
+        virtualClock = chosen->virtualMs;
+        chosen->busy = true;
+        running++;
+        pool.Submit([this, chosen, packet = std::move(packet)]() mutable {Process(chosen, std::move(packet));});
+    }
+}
+
+void MultiStreamPipeline::Process (Stream *stream, FramePacket packet) {
+    FrameTracer::Context context;
+    context.frame = packet.index;
+    context.stream = (int)stream->index;
+    FrameTracer::SetContext(context);
+    auto start = std::chrono::steady_clock::now();
+    stream->manager.SetFrame(packet.original);
+    stream->manager.UpdateFrame();
+    packet.edited = stream->manager.GetCurrentFrame();
+    packet.redimensioned = stream->manager.GetRedimensionedFrame();
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> cost = end - start,
+                                              latency = end - packet.captureTime;
+    stream->profiler.Record(Stage::EndToEnd, latency.count());
+    stream->processed++;
+
+    if (!stream->recordFailed && stream->recorder.HasWriteFailed()) {
+        std::cout << "Failed to write video file " << stream->config.outputFile << std::endl;
+        stream->recordFailed = true;
+    }
+    if (!stream->config.outputFile.empty() && !stream->recordFailed) {
+        if (!stream->recorder.IsRecording()
+            && !stream->recorder.Start(stream->config.outputFile, packet.edited.size(), stream->fps, packet.edited.type())) {
+            std::cout << "Failed to open video file " << stream->config.outputFile << std::endl;
+            stream->recordFailed = true;
+        } else {
+            stream->recorder.Submit(packet.edited, packet.captureTime);
+        }
+    }
+    if (onFrame) {onFrame(stream->index, packet);}
+    packet = FramePacket();     // Buffers go back to their pools before the next frame
+
+    // Nothing may touch the pipeline once the lock is released: WaitIdle()
+    // can then return and the pipeline be destroyed
+    std::lock_guard<std::mutex> lock(scheduleMutex);
+    stream->busy = false;
+    stream->virtualMs += cost.count() / stream->config.weight;
+    running--;
+    DispatchLocked();
+    idle.notify_all();
+}
+
+void MultiStreamPipeline::WaitIdle () {
+    std::unique_lock<std::mutex> lock(scheduleMutex);
+    for (;;) {
+        bool empty = running == 0;
+        for (std::unique_ptr<Stream> &stream : streams) {
+            if (stream->queue.GetStats().depth > 0) {empty = false;}
+        }
+        if (empty) return;
+        // Queued frames are picked up by Dispatch, not by a notification
+        idle.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+bool MultiStreamPipeline::IsFinished () {
+    for (std::unique_ptr<Stream> &stream : streams) {
+        if (!stream->external && !stream->captureDone) {return false;}
+        if (stream->queue.GetStats().depth > 0) {return false;}
+    }
+    std::lock_guard<std::mutex> lock(scheduleMutex);
+    return running == 0;
+}
+
+std::vector<StreamStats> MultiStreamPipeline::GetStats () {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    std::vector<StreamStats> all;
+    for (std::unique_ptr<Stream> &stream : streams) {
+        StreamStats stats;
+        stats.source = stream->external ? "stream " + std::to_string(stream->index) : stream->config.source;
+        stats.captured = stream->captured;
+        stats.processed = stream->processed;
+        stats.dropped = stream->queue.GetStats().dropped;
+        stats.recorded = stream->recorder.GetStats().written;
+        stats.fps = elapsed.count() > 0 ? stats.processed / elapsed.count() : 0;
+        StageSummary latency = stream->profiler.Summary(Stage::EndToEnd);
+        stats.latencyP50 = latency.p50;
+        stats.latencyP95 = latency.p95;
+        stats.processP50 = stream->profiler.Summary(Stage::Process).p50;
+        stats.incremental = stream->manager.GetIncrementalStats();
+        all.push_back(stats);
+    }
+    return all;
+}
@@ -0,0 +1,111 @@
+#ifndef MULTISTREAMPIPELINE_HPP
+#define MULTISTREAMPIPELINE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AsyncRecorder.hpp"
+#include "FilterSpec.hpp"
+#include "FrameQueue.hpp"
+#include "FrameSource.hpp"
+#include "StageProfiler.hpp"
+#include "VideoManager.hpp"
+#include "VideoPipeline.hpp"
+#include "WorkStealingPool.hpp"
+
+struct StreamConfig {
+    std::string source;             // See FrameSource::Open; empty: frames come from Submit()
+    FilterSpec spec;
+    std::string outputFile;         // Empty: not recorded
+    RecorderConfig recorder;        // One encoder thread per stream, dropping when full
+    double weight = 1;              // Share of the pool when streams compete
+    bool incremental = false;       // See VideoManager::SetIncrementalMode
+    double incrementalTolerance = 0;
+    size_t queueCapacity = 2;       // Cameras drop the oldest frame when it is full;
+                                    // files and Submit() wait, so no frame is lost
+
+    StreamConfig();
+};
+
+struct StreamStats {
+    std::string source;
+    long long captured = 0,
+              processed = 0,
+              dropped = 0,          // Replaced in the queue before being processed
+              recorded = 0;
+    double fps = 0,                 // Processed frames per second since Start
+           latencyP50 = 0,          // Capture to processed, ms
+           latencyP95 = 0,
+           processP50 = 0;          // UpdateFrame alone, ms
+    IncrementalStats incremental;   // All zero unless StreamConfig::incremental
+};
+
+// Several sources, each with its own VideoManager and recorder, processed
+// on one shared WorkStealingPool. Only captures have a thread each (they
+// mostly wait on the device); frames are processed by pool tasks, at most
+// one per stream at a time and no more than the pool has workers. Among
+// streams with a frame waiting, the one that used the least processing
+// time (divided by its weight) goes first, so an expensive stream gets its
+// share of the pool but cannot starve the others.
+class MultiStreamPipeline {
+    private:
+        struct Stream;
+
+        WorkStealingPool &pool;
+        std::vector<std::unique_ptr<Stream>> streams;
+        std::function<void(size_t, const FramePacket&)> onFrame;
+
+        std::mutex scheduleMutex;
+        std::condition_variable idle;
+        size_t running = 0;             // Frames being processed
+        double virtualClock = 0;        // Least weighted time of the streams last started
+        std::atomic<bool> started {false};
+        std::chrono::steady_clock::time_point startTime;
+
+        void CaptureLoop(Stream *stream);
+        void Dispatch();
+        void DispatchLocked();
+        void Process(Stream *stream, FramePacket packet);
+
+    public:
+        explicit MultiStreamPipeline(WorkStealingPool &pool);
+        ~MultiStreamPipeline();
+
+        // Opens the source; returns the stream's index, or -1 if it can't be opened.
+        // Live sources drop the oldest queued frame when processing falls behind.
+        int AddStream(const StreamConfig &config);
+
+        // Called from pool threads with every processed frame (set before Start)
+        void SetFrameCallback(std::function<void(size_t, const FramePacket&)> callback);
+
+        // Trace every stream's stages (set after adding the streams)
+        void SetTracer(FrameTracer *tracer);
+
+        // Direct access to a stream's settings
+        VideoManager& Manager(size_t stream);
+
+        void Start();
+        void Stop();
+
+        // Feed a stream without a source; false if the frame was not queued
+        bool Submit(size_t stream, const cv::Mat &frame,
+                    std::chrono::steady_clock::time_point captureTime = std::chrono::steady_clock::now());
+
+        // Block until every queued frame was processed
+        void WaitIdle();
+
+        // True once every source ended and all its frames were processed
+        bool IsFinished();
+
+        size_t StreamCount();
+        std::vector<StreamStats> GetStats();
+};
+
+#endif
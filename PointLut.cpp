@@ -0,0 +1,106 @@
+#include "PointLut.hpp"
+#include <opencv2/opencv.hpp>
+using namespace cv;
+
+// Fixed-point BGR->GRAY weights of cvtColor for 8-bit images
+struct GreyWeights {
+    int shift, b, g, r;
+};
+
+// OpenCV 4 uses 15-bit weights, OpenCV 3 used 14-bit ones; ask this build
+// which once, on a pattern where the two give different greys
+static const GreyWeights& CvtColorGreyWeights () {
+    static const GreyWeights weights = []() {
+        const GreyWeights candidates[] = {{15, 3735, 19235, 9798}, {14, 1868, 9617, 4899}};
+        Mat probe(256, 256, CV_8UC3),
+            grey;
+        for (int y = 0; y < 256; y++) {
+            for (int x = 0; x < 256; x++) {probe.at<Vec3b>(y, x) = Vec3b((uchar)x, (uchar)y, (uchar)((x*7 + y*13) & 255));}
+        }
+        cvtColor(probe, grey, COLOR_BGR2GRAY);
+        for (const GreyWeights &candidate : candidates) {
+            bool same = true;
+            for (int y = 0; same && y < 256; y++) {
+                for (int x = 0; same && x < 256; x++) {
+                    Vec3b in = probe.at<Vec3b>(y, x);
+                    int mixed = (in[0]*candidate.b + in[1]*candidate.g + in[2]*candidate.r + (1 << (candidate.shift - 1))) >> candidate.shift;
+                    same = mixed == grey.at<uchar>(y, x);
+                }
+            }
+            if (same) {return candidate;}
+        }
+        return candidates[0];
+    }();
+    return weights;
+}
+
+void PointLut::Build (float contrast, int brightness, bool negative, bool greyScale) {
+    this->greyScale = greyScale;
+    identity = contrast == 1 && brightness == 0 && !negative && !greyScale;
+
+    // Run the exact same conversions the per-frame chain used on every
+    // possible value, so the tables reproduce it bit for bit
+    Mat ramp(1, 256, CV_8U);
+    for (int i = 0; i < 256; i++) {ramp.at<uchar>(i) = (uchar)i;}
+
+    Mat adjusted, inverted;
+    ramp.convertTo(adjusted, -1, contrast, brightness);
+    if (negative) {
+        ramp.convertTo(inverted, -1, -1, 255);
+    } else {
+        inverted = ramp;
+    }
+
+    if (greyScale) {
+        // Brightness/contrast go into the weights, negative after the mix
+        const GreyWeights &grey = CvtColorGreyWeights();
+        greyShift = grey.shift;
+        for (int i = 0; i < 256; i++) {
+            int v = adjusted.at<uchar>(i);
+            weightB[i] = v*grey.b;
+            weightG[i] = v*grey.g;
+            weightR[i] = v*grey.r + (1 << (grey.shift - 1));
+            negativeLut[i] = inverted.at<uchar>(i);
+        }
+    }
+    // A frame that is already grey only needs brightness, contrast and negative
+    lut.create(1, 256, CV_8U);
+    for (int i = 0; i < 256; i++) {
+        lut.at<uchar>(i) = inverted.at<uchar>(adjusted.at<uchar>(i));
+    }
+}
+
+bool PointLut::IsIdentity () const {
+    return identity;
+}
+
+int PointLut::OutputChannels (int channels) const {
+    return greyScale ? 1 : channels;
+}
+
+void PointLut::Apply (const Mat &src, Mat &dst) const {
+    if (identity) {
+        src.copyTo(dst);
+        return;
+    }
+
+    if (!greyScale || src.channels() == 1) {
+        LUT(src, lut, dst);
+        return;
+    }
+
+    // Greyscale: adjust, mix and invert into a single channel in one go.
+    // Expanding it back to BGR gives what cvtColor's GRAY2BGR did before.
+    Mat input = src;    // Still the source if dst was src
+    dst.create(input.size(), CV_8UC1);
+    parallel_for_(Range(0, input.rows), [&](const Range &range) {
+        for (int y = range.start; y < range.end; y++) {
+            const uchar *in = input.ptr<uchar>(y);
+            uchar *out = dst.ptr<uchar>(y);
+            for (int x = 0; x < input.cols; x++, in += 3) {
+                int grey = (weightB[in[0]] + weightG[in[1]] + weightR[in[2]]) >> greyShift;
+                out[x] = negativeLut[grey];
+            }
+        }
+    });
+}
@@ -0,0 +1,35 @@
+#ifndef POINTLUT_HPP
+#define POINTLUT_HPP
+
+#include <opencv2/opencv.hpp>
+
+// Brightness, contrast, greyscale and negative folded into lookup tables,
+// so that all of them cost a single pass over the frame.
+class PointLut {
+    private:
+        cv::Mat lut;                // 1x256 CV_8U: negative(contrast*i + brightness)
+                                    // (colour frames, and any single-channel frame)
+        uchar negativeLut[256];     // Applied to the grey value when greyScale is on
+        int weightB[256],           // Greyscale weights, already including
+            weightG[256],           // brightness and contrast
+            weightR[256],
+            greyShift = 15;         // The weights' fixed-point bits (cvtColor's)
+        bool greyScale = false,
+             identity = true;
+
+    public:
+        // Rebuild the tables for new settings
+        void Build(float contrast, int brightness, bool negative, bool greyScale);
+
+        // True if Apply() would leave the frame untouched
+        bool IsIdentity() const;
+
+        // Channels Apply() outputs for a frame with the given number
+        int OutputChannels(int channels) const;
+
+        // Apply every point operation to a CV_8UC3 or CV_8UC1 frame (dst may
+        // be src); greyscale turns a colour frame into a single-channel one
+        void Apply(const cv::Mat &src, cv::Mat &dst) const;
+};
+
+#endif
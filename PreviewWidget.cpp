@@ -0,0 +1,128 @@
+#include "PreviewWidget.hpp"
+#include <QCloseEvent>
+#include <QGuiApplication>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QScreen>
+#include <QTimer>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#define PREVIEW_WIDTH 1280
+#define PREVIEW_HEIGHT 500
+#define TITLE_HEIGHT 20
+#define DEFAULT_REFRESH_HZ 60
+
+PreviewWidget::PreviewWidget (StageProfiler *profiler, QWidget *parent)
+    : QWidget(parent), profiler(profiler) {
+    setWindowTitle("Preview");
+    resize(PREVIEW_WIDTH, PREVIEW_HEIGHT);
+    setAttribute(Qt::WA_OpaquePaintEvent);     // Every pixel is painted, no background fill
+    setFocusPolicy(Qt::StrongFocus);
+
+    QScreen *screen = QGuiApplication::primaryScreen();
+    double hz = screen && screen->refreshRate() > 0 ? screen->refreshRate() : DEFAULT_REFRESH_HZ;
+    refreshMs = 1000.0/hz;
+    sinceRepaint.start();
+}
+
+QImage PreviewWidget::Wrap (const cv::Mat &frame) {
+    if (frame.empty()) {return QImage();}
+    if (frame.type() == CV_8UC1) {
+        return QImage(frame.data, frame.cols, frame.rows, (int)frame.step, QImage::Format_Grayscale8);
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    return QImage(frame.data, frame.cols, frame.rows, (int)frame.step, QImage::Format_BGR888);
+#else
+    // No BGR format before Qt 5.14: one swapped copy
+    return QImage(frame.data, frame.cols, frame.rows, (int)frame.step, QImage::Format_RGB888).rgbSwapped();
+#endif
+}
+
+void PreviewWidget::Present (const FramePacket &packet) {
+    original = packet.original;
+    edited = packet.redimensioned;
+    quality = packet.quality;
+    frameIndex = packet.index;
+    captureTime = packet.captureTime;
+    unpainted = true;
+    presented++;
+
+    // One repaint per refresh: later frames just replace this one
+    if (repaintScheduled) return;
+    repaintScheduled = true;
+    double wait = refreshMs - sinceRepaint.nsecsElapsed()/1e6;
+    if (wait <= 0) {
+        update();
+    } else {
+        QTimer::singleShot((int)std::ceil(wait), this, [this]() {update();});
+    }
+}
+
+void PreviewWidget::PaintFrame (QPainter &painter, const QImage &image, QRect area, const QString &title) {
+    painter.fillRect(area, Qt::black);
+    painter.setPen(Qt::white);
+    painter.drawText(area.left(), area.top(), area.width(), TITLE_HEIGHT, Qt::AlignCenter, title);
+    if (image.isNull()) return;
+
+    // Largest rectangle with the frame's aspect ratio
+    QRect box = area.adjusted(0, TITLE_HEIGHT, 0, 0);
+    QSize size = image.size().scaled(box.size(), Qt::KeepAspectRatio);
+    QRect target(box.left() + (box.width() - size.width())/2, box.top() + (box.height() - size.height())/2,
+                 size.width(), size.height());
+    painter.drawImage(target, image);
+}
+
+void PreviewWidget::paintEvent (QPaintEvent*) {
+    repaintScheduled = false;
+    sinceRepaint.restart();
+    FrameTracer::SetFrame(frameIndex);
+    {
+        StageTimer timer(profiler, Stage::Display);
+        QPainter painter(this);
+        int half = width()/2;
+        QString editedTitle = quality == QualityLevel::Full ? QString("Edited")
+                            : QString("Edited (%1)").arg(QualityScheduler::LevelName(quality));
+        PaintFrame(painter, Wrap(original), QRect(0, 0, half, height()), "Original");
+        PaintFrame(painter, Wrap(edited), QRect(half, 0, width() - half, height()), editedTitle);
+    }
+
+    if (unpainted) {
+        unpainted = false;
+        painted++;
+        if (profiler) {
+            std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - captureTime;
+            profiler->Record(Stage::EndToEnd, latency.count());
+        }
+    }
+}
+
+void PreviewWidget::keyPressEvent (QKeyEvent *event) {
+    FrameTracer *tracer = profiler ? profiler->Tracer() : nullptr;
+    if (event->key() == Qt::Key_Escape) {
+        exitRequested = true;
+    } else if (event->key() == Qt::Key_T && tracer) {
+        // Snapshot of the trace so far; recording goes on
+        std::cout << (tracer->Write() ? "Trace saved to " : "Failed to save trace to ") << tracer->Path() << std::endl;
+    } else {
+        QWidget::keyPressEvent(event);
+    }
+}
+
+void PreviewWidget::closeEvent (QCloseEvent *event) {
+    exitRequested = true;
+    event->accept();
+}
+
+bool PreviewWidget::IsExitRequested () {
+    return exitRequested;
+}
+
+long long PreviewWidget::Presented () {
+    return presented;
+}
+
+long long PreviewWidget::Painted () {
+    return painted;
+}
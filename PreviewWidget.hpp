@@ -0,0 +1,54 @@
+#ifndef PREVIEWWIDGET_HPP
+#define PREVIEWWIDGET_HPP
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QWidget>
+#include <opencv2/core.hpp>
+#include "StageProfiler.hpp"
+#include "VideoPipeline.hpp"
+
+// Original and edited frames side by side in one Qt window. Frames are
+// painted straight from the cv::Mat buffers (wrapped in a QImage, not
+// copied), at most once per display refresh: a frame that arrives before
+// the previous one was painted replaces it instead of queuing a repaint.
+class PreviewWidget : public QWidget {
+    private:
+        StageProfiler *profiler;
+        cv::Mat original,               // Latest frames, kept alive until replaced
+                edited;
+        QualityLevel quality = QualityLevel::Full;
+        long long frameIndex = -1;
+        std::chrono::steady_clock::time_point captureTime;
+        bool unpainted = false,         // Latest frame not painted yet
+             repaintScheduled = false,
+             exitRequested = false;
+        QElapsedTimer sinceRepaint;
+        double refreshMs;
+        long long presented = 0,
+                  painted = 0;
+
+        // Shares the frame's pixels; only valid while the Mat is
+        static QImage Wrap(const cv::Mat &frame);
+        void PaintFrame(QPainter &painter, const QImage &image, QRect area, const QString &title);
+
+    protected:
+        void paintEvent(QPaintEvent *event) override;
+        void keyPressEvent(QKeyEvent *event) override;
+        void closeEvent(QCloseEvent *event) override;
+
+    public:
+        explicit PreviewWidget(StageProfiler *profiler = nullptr, QWidget *parent = nullptr);
+
+        // Show a processed frame (end-to-end latency is recorded once it is painted)
+        void Present(const FramePacket &packet);
+
+        // ESC pressed or window closed (T saves the trace, when tracing)
+        bool IsExitRequested();
+
+        // Frames given to Present, and how many of them were actually painted
+        long long Presented();
+        long long Painted();
+};
+
+#endif
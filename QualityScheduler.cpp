@@ -0,0 +1,90 @@
+#include "QualityScheduler.hpp"
+#include <algorithm>
+
+#define MAX_RECOVER_BACKOFF 16      // framesToRecover grows up to this many times
+#define STABLE_FACTOR 10            // A level held this many framesToRecover resets the backoff
+
+QualityScheduler::QualityScheduler (QualityConfig config)
+    : config(config),
+      recoverWait(config.framesToRecover) {
+}
+
+QualityLevel QualityScheduler::Update (double frameMs) {
+    if (!config.enabled) {return QualityLevel::Full;}
+
+    // Skipping every other frame halves what each displayed frame costs
+    QualityLevel current = level;
+    double effective = current == QualityLevel::SkipFrames ? frameMs/2 : frameMs;
+    double smoothed = cost == 0 ? effective : cost + config.smoothing*(effective - cost);
+    cost = smoothed;
+    framesAtLevel++;
+
+    if (smoothed > config.deadlineMs*config.degradeAbove) {
+        overCount++;
+        underCount = 0;
+    } else if (smoothed < config.deadlineMs*config.recoverBelow) {
+        underCount++;
+        overCount = 0;
+    } else {
+        overCount = 0;
+        underCount = 0;
+    }
+
+    if (framesAtLevel >= recoverWait*STABLE_FACTOR) {recoverWait = config.framesToRecover;}
+
+    if (overCount >= config.framesToDegrade && current != QualityLevel::SkipFrames) {
+        // Stepping up was a mistake: wait longer before the next try
+        if (recoveredLast && framesAtLevel < recoverWait) {
+            recoverWait = std::min(recoverWait*2, config.framesToRecover*MAX_RECOVER_BACKOFF);
+        }
+        recoveredLast = false;
+        SetLevel((QualityLevel)((int)current + 1));
+    } else if (underCount >= recoverWait && current != QualityLevel::Full) {
+        recoveredLast = true;
+        SetLevel((QualityLevel)((int)current - 1));
+    }
+    return level;
+}
+
+void QualityScheduler::SetLevel (QualityLevel newLevel) {
+    level = newLevel;
+    changes++;
+    overCount = 0;
+    underCount = 0;
+    framesAtLevel = 0;
+    cost = 0;           // Costs at the old level say little about the new one
+}
+
+QualityLevel QualityScheduler::Level () {
+    return level;
+}
+
+bool QualityScheduler::ShouldSkip () {
+    if (level != QualityLevel::SkipFrames) {
+        skipNext = false;
+        return false;
+    }
+    bool skip = skipNext;
+    skipNext = !skipNext;
+    if (skip) {skipped++;}
+    return skip;
+}
+
+QualityStats QualityScheduler::GetStats () {
+    QualityStats stats;
+    stats.level = level;
+    stats.costMs = cost;
+    stats.changes = changes;
+    stats.skipped = skipped;
+    return stats;
+}
+
+const char* QualityScheduler::LevelName (QualityLevel level) {
+    switch (level) {
+    case QualityLevel::Full:            return "full quality";
+    case QualityLevel::HalfResolution:  return "half resolution";
+    case QualityLevel::SmallerGaussian: return "half resolution, smaller blur";
+    case QualityLevel::SkipFrames:      return "half resolution, smaller blur, skipping frames";
+    default:                            return "?";
+    }
+}
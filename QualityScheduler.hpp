@@ -0,0 +1,66 @@
+#ifndef QUALITYSCHEDULER_HPP
+#define QUALITYSCHEDULER_HPP
+
+#include <atomic>
+
+// Preview quality, in the order it is given up when frames take too long
+enum class QualityLevel {
+    Full,
+    HalfResolution,     // Filters run on a half-size frame, upscaled for display
+    SmallerGaussian,    // ...and the Gaussian kernel is halved too
+    SkipFrames          // ...and only every other preview frame is processed
+};
+
+struct QualityConfig {
+    bool enabled = true;
+    double deadlineMs = 1000.0/30,  // Processing budget per frame
+           degradeAbove = 1.0,      // Fraction of the budget that counts as over it
+           recoverBelow = 0.5,      // ...and as enough headroom to step back up
+           smoothing = 0.2;         // Weight of the newest frame in the running cost
+    int framesToDegrade = 5,        // Consecutive frames over budget before stepping down
+        framesToRecover = 60;       // ...and under it before stepping up
+};
+
+struct QualityStats {
+    QualityLevel level = QualityLevel::Full;
+    double costMs = 0;              // Running per-frame cost (after skipping)
+    long long changes = 0,
+              skipped = 0;
+};
+
+// Steps preview quality down when frames cost more than the deadline and
+// back up once there is headroom again. Both need several frames in a row,
+// and stepping up again right after a step down makes the next attempt wait
+// twice as long, so a level that is just at the limit does not flicker.
+// Update() and ShouldSkip() are called from the processing thread only.
+class QualityScheduler {
+    private:
+        QualityConfig config;
+        std::atomic<QualityLevel> level {QualityLevel::Full};
+        std::atomic<double> cost {0};
+        std::atomic<long long> changes {0},
+                               skipped {0};
+        int overCount = 0,
+            underCount = 0,
+            recoverWait,                // Current framesToRecover, after backoff
+            framesAtLevel = 0;
+        bool recoveredLast = false;     // Last change was a step up
+        bool skipNext = false;
+
+        void SetLevel(QualityLevel newLevel);
+
+    public:
+        explicit QualityScheduler(QualityConfig config = QualityConfig());
+
+        // Report what processing a frame took; returns the level for the next one
+        QualityLevel Update(double frameMs);
+        QualityLevel Level();
+
+        // True for the preview frames to drop at QualityLevel::SkipFrames
+        bool ShouldSkip();
+
+        QualityStats GetStats();
+        static const char* LevelName(QualityLevel level);
+};
+
+#endif
@@ -0,0 +1,288 @@
+#include "RawVideo.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <opencv2/imgproc.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace cv;
+
+#define RAW_CHUNK_BYTES (64LL << 20)    // Preallocated and mapped at a time (multiple of the page size)
+#define RAW_FRAME_ALIGN 64
+
+static_assert(sizeof(RawFileHeader) == 64, "RawFileHeader layout");
+static_assert(sizeof(RawFrameHeader) == 32, "RawFrameHeader layout");
+static_assert(sizeof(RawIndexEntry) == 16, "RawIndexEntry layout");
+
+// pwrite the whole buffer, retrying short writes
+static bool WriteAt (int fd, const void *data, size_t size, uint64_t offset) {
+    const uint8_t *bytes = (const uint8_t*)data;
+    while (size > 0) {
+        ssize_t n = pwrite(fd, bytes, size, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {return false;}
+        bytes += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+
+// Writer
+RawVideoWriter::~RawVideoWriter () {
+    Close();
+}
+
+bool RawVideoWriter::Open (const std::string &path, int width, int height, int type, double fps) {
+    Close();
+    if (type != CV_8UC3 && type != CV_8UC1) {return false;}
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {return false;}
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RAW_FILE_MAGIC, sizeof(header.magic));
+    header.version = 1;
+    header.headerBytes = RAW_HEADER_BYTES;
+    header.width = width;
+    header.height = height;
+    header.type = type;
+    header.fps = fps;
+    frameBytes = (size_t)width*height*CV_MAT_CN(type);
+    header.frameStride = (sizeof(RawFrameHeader) + frameBytes + RAW_FRAME_ALIGN - 1) / RAW_FRAME_ALIGN * RAW_FRAME_ALIGN;
+
+    std::vector<uint8_t> page(RAW_HEADER_BYTES, 0);
+    std::memcpy(page.data(), &header, sizeof(header));
+    position = 0;
+    allocated = 0;
+    index.clear();
+    if (!MapChunk(0) || !Append(page.data(), page.size())) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool RawVideoWriter::IsOpened () {
+    return fd >= 0;
+}
+
+bool RawVideoWriter::MapChunk (uint64_t offset) {
+    UnmapChunk();
+    // Reserve the blocks up front, so the disk gets long sequential extents.
+    // A mapping over blocks the disk can't provide raises SIGBUS on the first
+    // write, so only a file system that can't preallocate at all gets a
+    // sparse file; anything else (a full disk) fails the recording.
+    if (offset + RAW_CHUNK_BYTES > allocated) {
+        int error = posix_fallocate(fd, (off_t)offset, RAW_CHUNK_BYTES);
+        if (error != 0 && error != EOPNOTSUPP && error != EINVAL) {return false;}
+        if (error != 0 && ftruncate(fd, (off_t)(offset + RAW_CHUNK_BYTES)) != 0) {return false;}
+        allocated = offset + RAW_CHUNK_BYTES;
+    }
+    void *mapped = mmap(nullptr, RAW_CHUNK_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t)offset);
+    if (mapped == MAP_FAILED) {return false;}
+    madvise(mapped, RAW_CHUNK_BYTES, MADV_SEQUENTIAL);
+    chunk = (uint8_t*)mapped;
+    chunkOffset = offset;
+    return true;
+}
+
+void RawVideoWriter::UnmapChunk () {
+    if (!chunk) {return;}
+    // Start writing the full chunk back now rather than at the next sync
+    msync(chunk, RAW_CHUNK_BYTES, MS_ASYNC);
+    munmap(chunk, RAW_CHUNK_BYTES);
+    chunk = nullptr;
+}
+
+bool RawVideoWriter::Append (const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t*)data;
+    while (size > 0) {
+        if (!chunk || position >= chunkOffset + RAW_CHUNK_BYTES) {
+            if (!MapChunk(position / RAW_CHUNK_BYTES * RAW_CHUNK_BYTES)) {return false;}
+        }
+        size_t n = std::min<uint64_t>(size, chunkOffset + RAW_CHUNK_BYTES - position);
+        if (bytes) {
+            std::memcpy(chunk + (position - chunkOffset), bytes, n);
+            bytes += n;
+        } else {
+            std::memset(chunk + (position - chunkOffset), 0, n);    // Padding
+        }
+        position += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool RawVideoWriter::WriteFrame (const Mat &frame, int64_t timestampNs) {
+    if (fd < 0 || frame.cols != header.width || frame.rows != header.height) {return false;}
+
+    // Same layout as the file says, whatever the pipeline produced
+    Mat pixels = frame;
+    if (frame.type() != header.type) {
+        if (frame.depth() != CV_8U) {return false;}
+        cvtColor(frame, converted, header.type == CV_8UC1 ? COLOR_BGR2GRAY : COLOR_GRAY2BGR);
+        pixels = converted;
+    }
+
+    RawIndexEntry entry = {position, timestampNs};
+    RawFrameHeader frameHeader = {RAW_FRAME_MAGIC, (uint32_t)frameBytes, (uint64_t)index.size(), timestampNs, 0};
+    bool ok = Append(&frameHeader, sizeof(frameHeader));
+    if (pixels.isContinuous()) {
+        ok = ok && Append(pixels.data, frameBytes);
+    } else {
+        size_t rowBytes = frameBytes / pixels.rows;
+        for (int y = 0; ok && y < pixels.rows; y++) {ok = Append(pixels.ptr(y), rowBytes);}
+    }
+    ok = ok && Append(nullptr, header.frameStride - sizeof(frameHeader) - frameBytes);
+    if (!ok) {
+        // The index ends with the last complete frame
+        position = entry.offset;
+        return false;
+    }
+    index.push_back(entry);
+    return true;
+}
+
+void RawVideoWriter::Close () {
+    if (fd < 0) {return;}
+    UnmapChunk();
+
+    // Index and final header go through plain writes; the tail of the last chunk is cut off
+    uint64_t count = index.size();
+    uint64_t indexOffset = position;
+    bool ok = WriteAt(fd, &count, sizeof(count), indexOffset)
+           && WriteAt(fd, index.data(), index.size()*sizeof(RawIndexEntry), indexOffset + sizeof(count));
+    uint64_t end = indexOffset + sizeof(count) + index.size()*sizeof(RawIndexEntry);
+    ok = ok && WriteAt(fd, RAW_INDEX_MAGIC, 8, end);
+    if (ftruncate(fd, (off_t)(end + 8)) != 0) {ok = false;}
+    if (ok) {
+        header.frameCount = count;
+        header.indexOffset = indexOffset;
+        WriteAt(fd, &header, sizeof(header), 0);
+    }
+    close(fd);
+    fd = -1;
+}
+
+long long RawVideoWriter::FramesWritten () {
+    return (long long)index.size();
+}
+
+long long RawVideoWriter::BytesWritten () {
+    return (long long)position;
+}
+
+
+// Reader
+RawVideoReader::~RawVideoReader () {
+    Close();
+}
+
+bool RawVideoReader::Open (const std::string &path) {
+    Close();
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {return false;}
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < RAW_HEADER_BYTES) {
+        Close();
+        return false;
+    }
+    fileBytes = (size_t)info.st_size;
+    void *mapped = mmap(nullptr, fileBytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        Close();
+        return false;
+    }
+    data = (const uint8_t*)mapped;
+    madvise(mapped, fileBytes, MADV_SEQUENTIAL);
+
+    std::memcpy(&header, data, sizeof(header));
+    size_t frameBytes = (size_t)header.width*header.height*CV_MAT_CN(header.type);
+    if (std::memcmp(header.magic, RAW_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != 1
+        || (header.type != CV_8UC3 && header.type != CV_8UC1) || header.width <= 0 || header.height <= 0
+        || header.frameStride < sizeof(RawFrameHeader) + frameBytes) {
+        Close();
+        return false;
+    }
+
+    indexed = ReadIndex();
+    if (!indexed) {ScanFrames();}
+    return true;
+}
+
+bool RawVideoReader::ReadIndex () {
+    if (header.indexOffset == 0 || header.frameCount > fileBytes/sizeof(RawIndexEntry)) {return false;}
+    uint64_t count;
+    size_t end = header.indexOffset + sizeof(count) + header.frameCount*sizeof(RawIndexEntry);
+    if (header.indexOffset + sizeof(count) > fileBytes || end + 8 > fileBytes
+        || std::memcmp(data + end, RAW_INDEX_MAGIC, 8) != 0) {return false;}
+    std::memcpy(&count, data + header.indexOffset, sizeof(count));
+    if (count != header.frameCount) {return false;}
+
+    offsets.resize(count);
+    timestamps.resize(count);
+    const uint8_t *entries = data + header.indexOffset + sizeof(count);
+    for (uint64_t i = 0; i < count; i++) {
+        RawIndexEntry entry;
+        std::memcpy(&entry, entries + i*sizeof(entry), sizeof(entry));
+        if (entry.offset + header.frameStride > header.indexOffset) {return false;}
+        offsets[i] = entry.offset;
+        timestamps[i] = entry.timestampNs;
+    }
+    return true;
+}
+
+void RawVideoReader::ScanFrames () {
+    // Recording cut short: keep every complete frame before the first gap
+    offsets.clear();
+    timestamps.clear();
+    for (uint64_t offset = RAW_HEADER_BYTES; offset + header.frameStride <= fileBytes; offset += header.frameStride) {
+        RawFrameHeader frameHeader;
+        std::memcpy(&frameHeader, data + offset, sizeof(frameHeader));
+        if (frameHeader.magic != RAW_FRAME_MAGIC || frameHeader.sequence != offsets.size()) break;
+        offsets.push_back(offset);
+        timestamps.push_back(frameHeader.timestampNs);
+    }
+}
+
+void RawVideoReader::Close () {
+    if (data) {munmap((void*)data, fileBytes);}
+    data = nullptr;
+    if (fd >= 0) {close(fd);}
+    fd = -1;
+    offsets.clear();
+    timestamps.clear();
+    indexed = false;
+}
+
+long long RawVideoReader::FrameCount () {
+    return (long long)offsets.size();
+}
+
+Size RawVideoReader::FrameSize () {
+    return Size(header.width, header.height);
+}
+
+int RawVideoReader::FrameType () {
+    return header.type;
+}
+
+double RawVideoReader::Fps () {
+    return header.fps;
+}
+
+bool RawVideoReader::HasIndex () {
+    return indexed;
+}
+
+Mat RawVideoReader::Frame (long long i) {
+    if (i < 0 || i >= FrameCount()) {return Mat();}
+    return Mat(header.height, header.width, header.type, (void*)(data + offsets[i] + sizeof(RawFrameHeader)));
+}
+
+int64_t RawVideoReader::TimestampNs (long long i) {
+    return i >= 0 && i < FrameCount() ? timestamps[i] : 0;
+}
@@ -0,0 +1,120 @@
+#ifndef RAWVIDEO_HPP
+#define RAWVIDEO_HPP
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Uncompressed recordings (.dkraw), for when JPEG encoding can't keep up.
+//
+// Layout (little-endian):
+//   RawFileHeader, padded to RAW_HEADER_BYTES
+//   frame i at RAW_HEADER_BYTES + i*frameStride: RawFrameHeader, then the
+//     rows packed without padding (BGR or grey, as in cv::Mat)
+//   index: uint64 count, count RawIndexEntry, then RAW_INDEX_MAGIC
+// Every frame has the same size and type, so frames can also be found
+// without the index, as they are in a file whose recording was cut short.
+#define RAW_HEADER_BYTES 4096
+#define RAW_FILE_MAGIC "DKYRAW1"
+#define RAW_FRAME_MAGIC 0x52464b44u     // "DKFR"
+#define RAW_INDEX_MAGIC "DKYIDX1"
+
+struct RawFileHeader {
+    char magic[8];
+    uint32_t version,
+             headerBytes;
+    int32_t width,
+            height,
+            type,                   // OpenCV type: CV_8UC3 or CV_8UC1
+            reserved;
+    double fps;
+    uint64_t frameStride,           // Frame header + pixels, rounded up to 64 bytes
+             frameCount,            // Both zero until the file is closed
+             indexOffset;
+};
+
+struct RawFrameHeader {
+    uint32_t magic,
+             payloadBytes;
+    uint64_t sequence;
+    int64_t timestampNs;            // Since the first frame
+    uint64_t reserved;
+};
+
+struct RawIndexEntry {
+    uint64_t offset;
+    int64_t timestampNs;
+};
+
+// Writes through a memory-mapped file that grows in large preallocated
+// chunks: each frame is one copy into the page cache, and the kernel writes
+// the chunks back sequentially. No encoding, so only disk bandwidth limits it.
+class RawVideoWriter {
+    private:
+        int fd = -1;
+        RawFileHeader header;
+        size_t frameBytes = 0;          // Pixels only
+        uint8_t *chunk = nullptr;       // Mapped part of the file
+        uint64_t chunkOffset = 0,
+                 position = 0,          // Next byte to write
+                 allocated = 0;         // File size so far
+        std::vector<RawIndexEntry> index;
+        cv::Mat converted;
+
+        bool MapChunk(uint64_t offset);
+        void UnmapChunk();
+        bool Append(const void *data, size_t size);
+
+    public:
+        ~RawVideoWriter();
+
+        // type: CV_8UC3 or CV_8UC1; other frames are converted to it.
+        // False if the file or its first chunk can't be created
+        bool Open(const std::string &path, int width, int height, int type, double fps);
+        bool IsOpened();
+
+        // False if the frame doesn't fit the file, or the disk is full
+        // (the file then keeps every frame before it)
+        bool WriteFrame(const cv::Mat &frame, int64_t timestampNs);
+
+        // Writes the index and final header, trims the preallocated tail
+        void Close();
+
+        long long FramesWritten();
+        long long BytesWritten();
+};
+
+// Maps a whole .dkraw file; Frame(i) is a header over the mapping (no copy,
+// valid while the reader is open) found in constant time.
+class RawVideoReader {
+    private:
+        int fd = -1;
+        const uint8_t *data = nullptr;
+        size_t fileBytes = 0;
+        RawFileHeader header;
+        std::vector<uint64_t> offsets;
+        std::vector<int64_t> timestamps;
+        bool indexed = false;
+
+        bool ReadIndex();
+        void ScanFrames();
+
+    public:
+        ~RawVideoReader();
+
+        bool Open(const std::string &path);
+        void Close();
+
+        long long FrameCount();
+        cv::Size FrameSize();
+        int FrameType();
+        double Fps();
+        // False if the file was not closed properly and the frames were recovered by scanning
+        bool HasIndex();
+
+        cv::Mat Frame(long long i);
+        int64_t TimestampNs(long long i);
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "StageProfiler.hpp"
+#include <algorithm>
+#include <vector>
+
+StageProfiler::StageProfiler () {
+    for (Window &window : windows) {
+        for (std::atomic<float> &sample : window.samples) {
+            sample.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void StageProfiler::SetTracer (FrameTracer *tracer) {
+    this->tracer = tracer;
+}
+
+FrameTracer* StageProfiler::Tracer () {
+    return tracer.load(std::memory_order_relaxed);
+}
+
+void StageProfiler::Record (Stage stage, double milliseconds) {
+    Window &window = windows[(int)stage];
+    uint32_t slot = window.next.fetch_add(1, std::memory_order_relaxed) % PROFILER_WINDOW;
+    window.samples[slot].store((float)milliseconds, std::memory_order_relaxed);
+    window.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+StageSummary StageProfiler::Summary (Stage stage) {
+    Window &window = windows[(int)stage];
+    StageSummary summary;
+    summary.count = window.count.load(std::memory_order_relaxed);
+
+    size_t used = (size_t)std::min<long long>(summary.count, PROFILER_WINDOW);
+    if (used == 0) {return summary;}
+    std::vector<float> sorted(used);
+    for (size_t i = 0; i < used; i++) {
+        sorted[i] = window.samples[i].load(std::memory_order_relaxed);
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [&sorted](double p) -> double {
+        return sorted[(size_t)(p * (sorted.size() - 1) + 0.5)];
+    };
+    summary.p50 = percentile(0.50);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    summary.max = sorted.back();
+    return summary;
+}
+
+const char* StageProfiler::StageName (Stage stage) {
+    switch (stage) {
+    case Stage::Capture:        return "Capture";
+    case Stage::Temporal:       return "Temporal";
+    case Stage::Exposure:       return "Exposure";
+    case Stage::Mirror:         return "Mirror";
+    case Stage::PointOps:       return "Bright/contrast";
+    case Stage::Gaussian:       return "Gaussian";
+    case Stage::EdgeDetection:  return "Edges";
+    case Stage::Gradient:       return "Gradient";
+    case Stage::Geometry:       return "Zoom/rotate";
+    case Stage::Process:        return "UpdateFrame";
+    case Stage::Record:         return "Record";
+    case Stage::Display:        return "Display";
+    case Stage::EndToEnd:       return "End to end";
+    default:                    return "?";
+    }
+}
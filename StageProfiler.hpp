@@ -0,0 +1,89 @@
+#ifndef STAGEPROFILER_HPP
+#define STAGEPROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "FrameTracer.hpp"
+
+#define PROFILER_WINDOW 256     // Samples kept per stage (rolling window)
+
+// Every timed step a frame goes through
+enum class Stage {
+    Capture,
+    Temporal,
+    Exposure,       // Auto exposure histogram
+    Mirror,
+    PointOps,
+    Gaussian,
+    EdgeDetection,
+    Gradient,
+    Geometry,
+    Process,        // The whole UpdateFrame
+    Record,
+    Display,
+    EndToEnd,       // From capture to display
+    Count
+};
+
+#define STAGE_COUNT ((int)Stage::Count)
+
+struct StageSummary {
+    double p50 = 0,
+           p95 = 0,
+           p99 = 0,
+           max = 0;
+    long long count = 0;
+};
+
+// Keeps the last PROFILER_WINDOW durations of each stage.
+// Recording is one atomic store, so it can sit on the hot path of any
+// thread; percentiles are only computed when someone asks for them.
+class StageProfiler {
+    private:
+        struct Window {
+            std::atomic<float> samples[PROFILER_WINDOW];
+            std::atomic<uint32_t> next {0};
+            std::atomic<long long> count {0};
+        };
+
+        Window windows[STAGE_COUNT];
+        std::atomic<FrameTracer*> tracer {nullptr};
+
+    public:
+        StageProfiler();
+
+        // Every stage timed from now on is also a span of this trace (nullptr: none)
+        void SetTracer(FrameTracer *tracer);
+        FrameTracer* Tracer();
+
+        void Record(Stage stage, double milliseconds);
+        StageSummary Summary(Stage stage);
+        static const char* StageName(Stage stage);
+};
+
+// Times the enclosing scope (and traces it, if the profiler has a tracer);
+// does nothing without a profiler
+class StageTimer {
+    private:
+        StageProfiler *profiler;
+        Stage stage;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        StageTimer (StageProfiler *profiler, Stage stage)
+            : profiler(profiler), stage(stage) {
+            if (profiler) {start = std::chrono::steady_clock::now();}
+        }
+
+        ~StageTimer () {
+            if (profiler) {
+                std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+                std::chrono::duration<double, std::milli> elapsed = end - start;
+                profiler->Record(stage, elapsed.count());
+                if (FrameTracer *tracer = profiler->Tracer()) {tracer->Record(StageProfiler::StageName(stage), start, end);}
+            }
+        }
+};
+
+#endif
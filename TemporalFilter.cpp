@@ -0,0 +1,106 @@
+#include "TemporalFilter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <opencv2/core.hpp>
+using namespace cv;
+
+#define RECIPROCAL_BITS 19      // sum*ceil(2^19/n) fits in 32 bits and divides exactly
+#define TRAIL_BITS 8            // Fractional bits of the trail
+
+// ceil(2^RECIPROCAL_BITS / n): (sum + n/2)*reciprocal >> RECIPROCAL_BITS is
+// sum/n rounded, exact for every sum a window of up to 32 frames can reach
+static uint32_t Reciprocal (int n) {
+    return ((1u << RECIPROCAL_BITS) + n - 1) / n;
+}
+
+void TemporalFilter::Apply (const Mat &src, Mat &dst, TemporalMode newMode, int newWindow, float blend) {
+    CV_Assert(src.depth() == CV_8U && src.data != dst.data);
+    dst.create(src.size(), src.type());
+    newWindow = std::max(1, std::min(newWindow, TEMPORAL_MAX_WINDOW));
+    if (newMode == TemporalMode::Off) {
+        src.copyTo(dst);
+        return;
+    }
+
+    // History of another shape, or kept for another filter, is useless
+    if (src.size() != size || src.type() != type || newMode != mode || newWindow != window) {
+        size = src.size();
+        type = src.type();
+        mode = newMode;
+        window = newWindow;
+        Reset();
+    }
+    size_t rowSamples = (size_t)size.width*src.channels(),
+           frameSamples = rowSamples*size.height;
+    if (accumulator.size() < frameSamples) {accumulator.resize(frameSamples);}
+    if (mode != TemporalMode::Trail && ring.size() < frameSamples*window) {ring.resize(frameSamples*window);}
+
+    bool first = filled == 0,
+         full = filled == window;
+    int count = std::min(filled + 1, window);           // Frames in the sum once this one is in
+    uint32_t reciprocal = Reciprocal(count),
+             previousReciprocal = Reciprocal(std::max(1, filled));
+    int weight = (int)std::lround(std::max(0.0f, std::min(blend, 1.0f)) * (1 << TRAIL_BITS));
+    uchar *slot = ring.data() + frameSamples*next;
+
+    parallel_for_(Range(0, size.height), [&](const Range &range) {
+        for (int y = range.start; y < range.end; y++) {
+            const uchar *in = src.ptr<uchar>(y);
+            uchar *out = dst.ptr<uchar>(y);
+            uint16_t *acc = accumulator.data() + rowSamples*y;
+            uchar *old = slot + rowSamples*y;
+            switch (mode) {
+            case TemporalMode::Average:
+                for (size_t i = 0; i < rowSamples; i++) {
+                    uint32_t sum = (first ? 0 : acc[i]) + in[i] - (full ? old[i] : 0);
+                    acc[i] = (uint16_t)sum;
+                    old[i] = in[i];
+                    out[i] = (uchar)(((sum + count/2)*reciprocal) >> RECIPROCAL_BITS);
+                }
+                break;
+            case TemporalMode::Trail:
+                for (size_t i = 0; i < rowSamples; i++) {
+                    int value = in[i] << TRAIL_BITS,
+                        trail = first ? value : acc[i];
+                    trail += ((value - trail)*weight) >> TRAIL_BITS;
+                    acc[i] = (uint16_t)trail;
+                    out[i] = (uchar)((trail + (1 << (TRAIL_BITS - 1))) >> TRAIL_BITS);
+                }
+                break;
+            case TemporalMode::Motion:
+                for (size_t i = 0; i < rowSamples; i++) {
+                    // Compared with the frames before this one, then added to them
+                    uint32_t sum = first ? 0 : acc[i];
+                    int mean = first ? in[i] : (int)(((sum + filled/2)*previousReciprocal) >> RECIPROCAL_BITS),
+                        shown = (in[i]*weight) >> TRAIL_BITS;
+                    sum += in[i] - (full ? old[i] : 0);
+                    acc[i] = (uint16_t)sum;
+                    old[i] = in[i];
+                    out[i] = (uchar)std::min(255, shown + std::abs(in[i] - mean));
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    });
+
+    filled = count;
+    next = (next + 1) % window;
+}
+
+void TemporalFilter::Reset () {
+    filled = 0;
+    next = 0;
+}
+
+const char* TemporalFilter::ModeName (TemporalMode mode) {
+    switch (mode) {
+    case TemporalMode::Off:         return "Off";
+    case TemporalMode::Average:     return "Denoise";
+    case TemporalMode::Trail:       return "Motion trail";
+    case TemporalMode::Motion:      return "Motion highlight";
+    default:                        return "?";
+    }
+}
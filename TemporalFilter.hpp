@@ -0,0 +1,48 @@
+#ifndef TEMPORALFILTER_HPP
+#define TEMPORALFILTER_HPP
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <vector>
+
+#define TEMPORAL_MAX_WINDOW 32      // Frames one running sum can hold (32*255 fits in 16 bits)
+
+// Filters that look at the frames before the current one
+enum class TemporalMode {
+    Off,
+    Average,    // Mean of the last `window` frames: denoise without blurring edges
+    Trail,      // Exponential moving average: moving objects leave a trail
+    Motion      // Difference from the mean of the previous `window` frames
+};
+
+// Keeps the last frames in a ring buffer along with a running 16-bit sum
+// of them per sample: each frame adds itself to the sum and subtracts the
+// frame it replaces, so a frame costs the same whatever the window length.
+// The trail keeps a running 16-bit value (8 fractional bits) instead.
+// Buffers only ever grow: after a resolution, mode or window change the
+// history starts over in the memory already allocated. One thread at a time.
+class TemporalFilter {
+    private:
+        std::vector<uchar> ring;            // window frames, packed one after another
+        std::vector<uint16_t> accumulator;  // Running sum (or trail) per sample
+        cv::Size size;
+        int type = -1,
+            window = 0,
+            filled = 0,                     // Frames the ring holds so far
+            next = 0;                       // Slot the next frame replaces
+        TemporalMode mode = TemporalMode::Off;
+
+    public:
+        // 8-bit src into dst (same shape, reused if it matches; not src).
+        // window: 1 to TEMPORAL_MAX_WINDOW frames (Average and Motion);
+        // blend: 0 to 1, weight of the newest frame in the trail, or how
+        // much of the frame shows under the highlighted motion
+        void Apply(const cv::Mat &src, cv::Mat &dst, TemporalMode mode, int window, float blend);
+
+        // Forget every frame seen so far (buffers are kept)
+        void Reset();
+
+        static const char* ModeName(TemporalMode mode);
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool (size_t threads) {
+    if (threads == 0) {threads = std::thread::hardware_concurrency();}
+    if (threads == 0) {threads = 1;}
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool () {
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread &worker : workers) {worker.join();}
+}
+
+size_t ThreadPool::Size () {
+    return workers.size();
+}
+
+void ThreadPool::Submit (std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        tasks.push_back(std::move(task));
+        pending++;
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::Wait () {
+    std::unique_lock<std::mutex> lock(tasksMutex);
+    allDone.wait(lock, [this]() {return pending == 0;});
+}
+
+void ThreadPool::WorkerLoop () {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(tasksMutex);
+            taskAvailable.wait(lock, [this]() {return stopping || !tasks.empty();});
+            if (tasks.empty()) {return;}
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+        {
+            std::lock_guard<std::mutex> lock(tasksMutex);
+            pending--;
+            if (pending == 0) {allDone.notify_all();}
+        }
+    }
+}
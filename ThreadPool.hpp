@@ -0,0 +1,36 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running submitted tasks
+class ThreadPool {
+    private:
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> tasks;
+        std::mutex tasksMutex;
+        std::condition_variable taskAvailable,
+                                allDone;
+        size_t pending = 0;
+        bool stopping = false;
+
+        void WorkerLoop();
+
+    public:
+        // Zero threads means one per hardware core
+        explicit ThreadPool(size_t threads = 0);
+        ~ThreadPool();
+
+        size_t Size();
+        void Submit(std::function<void()> task);
+
+        // Block until every submitted task has finished
+        void Wait();
+};
+
+#endif
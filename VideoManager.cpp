@@ -1,9 +1,157 @@
 #include "VideoManager.hpp"
+#include "FixedGaussian.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
-#include <opencv2/highgui.hpp>
 #include <opencv2/opencv.hpp>
 using namespace cv;
 
+// Rows a step reads above and below each row it writes
+static int HaloRows (PlanStep step, int gaussianKernelSize) {
+    switch (step) {
+    case PlanStep::Gaussian:    return gaussianKernelSize > 1 ? gaussianKernelSize/2 : 0;
+    case PlanStep::Gradient:    return 1;
+    default:                    return 0;
+    }
+}
+
+// Steps that only need nearby rows; geometry moves rows around and
+// Canny follows edges across the whole frame, so those run on full frames
+static bool IsStripStep (PlanStep step) {
+    return step == PlanStep::Mirror || step == PlanStep::PointOps
+        || step == PlanStep::Gaussian || step == PlanStep::Gradient;
+}
+
+static Stage StageOf (PlanStep step) {
+    switch (step) {
+    case PlanStep::Temporal:        return Stage::Temporal;
+    case PlanStep::Mirror:          return Stage::Mirror;
+    case PlanStep::PointOps:        return Stage::PointOps;
+    case PlanStep::Gaussian:        return Stage::Gaussian;
+    case PlanStep::EdgeDetection:   return Stage::EdgeDetection;
+    case PlanStep::Gradient:        return Stage::Gradient;
+    default:                        return Stage::Geometry;
+    }
+}
+
+// Filters of a frame, as trace spans show them
+static uint32_t TraceFilters (const FilterSettings &s, QualityLevel quality, bool incremental, bool proxy) {
+    uint32_t filters = 0;
+    if (s.mirrorH || s.mirrorV) {filters |= TraceMirror;}
+    if (s.rotation % 360 != 0) {filters |= TraceRotation;}
+    if (s.zoomOut > 0) {filters |= TraceZoomOut;}
+    if (s.brightness != 0 || s.contrast != 1) {filters |= TraceBrightContrast;}
+    if (s.greyScale) {filters |= TraceGreyscale;}
+    if (s.negativeFilter) {filters |= TraceNegative;}
+    if (s.gaussianFilter) {filters |= TraceGaussian;}
+    if (s.edgeDetection) {filters |= TraceEdges;}
+    if (s.gradientFilter) {filters |= TraceGradient;}
+    if (s.temporalMode != TemporalMode::Off) {filters |= TraceTemporal;}
+    if (s.autoExposure) {filters |= TraceAutoExposure;}
+    if (incremental) {filters |= TraceIncremental;}
+    if (quality != QualityLevel::Full) {filters |= TraceDegraded;}
+    if (proxy) {filters |= TraceProxy;}
+    return filters;
+}
+
+static FrameTracer* TracerOf (StageProfiler *profiler) {
+    return profiler ? profiler->Tracer() : nullptr;
+}
+
+#define STRIP_TARGET_BYTES (256*1024)   // Per strip buffer, to stay in L2
+#define MIN_STRIP_ROWS 16
+#define STRIPS_PER_THREAD 4             // Spare strips for load balancing
+#define INCREMENTAL_TILE 64             // Side of the tiles compared between frames
+
+// A run of consecutive filters that can be applied to any part of a frame
+struct VideoManager::Segment {
+    std::vector<PlanStep> steps;
+    const FilterPlan *plan;
+    int gaussianKernelSize,
+        halo = 0;                       // Context needed around a region, all steps together
+    GradientBackend backend;
+    std::vector<int> types;             // Frame type before each step, then the output's
+    std::unique_ptr<std::atomic<long long>[]> microseconds;    // Per step, all regions together
+
+    // Each region writes its steps' outputs into ROIs of a scratch set: one
+    // frame-wide buffer per step, tall enough for the tallest region plus
+    // its halo. Their shapes only depend on the frame and regionRows, so the
+    // pool serves the same few every frame, whatever the regions' sizes.
+    int regionRows = 0;
+    std::mutex scratchMutex;
+    std::vector<std::vector<cv::Mat>> spareScratch;
+
+    Segment (std::vector<PlanStep> steps, const FilterPlan &plan, int gaussianKernelSize,
+             GradientBackend backend, int inputType)
+        : steps(steps), plan(&plan), gaussianKernelSize(gaussianKernelSize), backend(backend),
+          types(steps.size() + 1), microseconds(new std::atomic<long long>[steps.size()]) {
+        types[0] = inputType;
+        for (size_t k = 0; k < steps.size(); k++) {
+            types[k + 1] = plan.OutputType(steps[k], types[k]);
+            halo += HaloRows(steps[k], gaussianKernelSize);
+            microseconds[k] = 0;
+        }
+    }
+
+    // Before handing out regions of at most rows rows
+    void SetRegionRows (int rows) {
+        std::lock_guard<std::mutex> lock(scratchMutex);
+        if (rows != regionRows) {spareScratch.clear();}
+        regionRows = rows;
+    }
+
+    std::vector<cv::Mat> TakeScratch (FramePool &pool, cv::Size frame) {
+        std::lock_guard<std::mutex> lock(scratchMutex);
+        if (!spareScratch.empty()) {
+            std::vector<cv::Mat> scratch = std::move(spareScratch.back());
+            spareScratch.pop_back();
+            return scratch;
+        }
+        std::vector<cv::Mat> scratch(steps.size());
+        int margin = 0;             // Halo of step k and every step after it, above and below
+        for (int k = (int)steps.size() - 1; k >= 0; k--) {
+            margin += HaloRows(steps[k], gaussianKernelSize);
+            int rows = std::min(frame.height, regionRows + 2*margin);
+            scratch[k] = pool.Acquire(cv::Size(frame.width, rows), types[k + 1]);
+        }
+        return scratch;
+    }
+
+    void ReturnScratch (std::vector<cv::Mat> scratch) {
+        std::lock_guard<std::mutex> lock(scratchMutex);
+        spareScratch.push_back(std::move(scratch));
+    }
+};
+
+// OpenCV's own threads are limited to one while any manager runs strips:
+// the strip pool already has a thread per core, and every filter calling
+// parallel_for_ inside a strip would otherwise start OpenCV's as well
+static std::mutex openCvThreadsMutex;
+static int stripManagers = 0,
+           savedOpenCvThreads = 0;
+
+static void ShareOpenCvThreads (bool runningStrips) {
+    std::lock_guard<std::mutex> lock(openCvThreadsMutex);
+    if (runningStrips && stripManagers++ == 0) {
+        savedOpenCvThreads = getNumThreads();
+        setNumThreads(1);
+    } else if (!runningStrips && --stripManagers == 0) {
+        setNumThreads(savedOpenCvThreads);
+    }
+}
+
+VideoManager::VideoManager ()
+    : gradientBackend(GradientMagnitude::DefaultBackend()) {
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    PublishPlan();
+}
+
+VideoManager::~VideoManager () {
+    if (stripPool) {ShareOpenCvThreads(false);}
+}
+
+
 // Frame getters + setters
 cv::Mat VideoManager::GetCurrentFrame () {
     return currentFrame;
@@ -14,23 +162,74 @@ cv::Mat VideoManager::GetRedimensionedFrame () {
 }
 
 void VideoManager::SetFrame (cv::Mat frame) {
+    TraceScope trace(TracerOf(profiler), "SetFrame");
     currentFrame = frame;
 }
 
+void VideoManager::SetProfiler (StageProfiler *profiler) {
+    this->profiler = profiler;
+}
+
+void VideoManager::SetFullResolutionOutput (bool enabled) {
+    fullResolutionOutput = enabled;
+}
+
+void VideoManager::SetPreviewQuality (QualityLevel level) {
+    previewQuality = level;
+}
+
+void VideoManager::SetPreviewProxy (int width) {
+    previewProxyWidth = width;
+}
+
+void VideoManager::SetGradientBackend (GradientBackend backend) {
+    gradientBackend = backend;
+}
+
+void VideoManager::SetIncrementalMode (bool enabled, double tolerance) {
+    incrementalTolerance = tolerance;
+    incremental = enabled;
+}
+
+IncrementalStats VideoManager::GetIncrementalStats () {
+    IncrementalStats stats;
+    stats.frames = incrementalFrames;
+    stats.tiles = incrementalTiles;
+    stats.reusedTiles = incrementalReused;
+    stats.uncoveredFrames = incrementalUncovered;
+    stats.hitRate = stats.tiles > 0 ? (double)stats.reusedTiles / stats.tiles : 0;
+    return stats;
+}
+
+void VideoManager::SetStripExecution (WorkStealingPool *pool, int rows) {
+    if ((pool != nullptr) != (stripPool != nullptr)) {ShareOpenCvThreads(pool != nullptr);}
+    stripPool = pool;
+    stripRows = rows;
+}
+
+FramePool& VideoManager::GetFramePool () {
+    return framePool;
+}
+
 
 // Adjust size, reflection and rotation
 void VideoManager::MirrorHorizontal () {
-    mirrorH = !mirrorH;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.mirrorH = !settings.mirrorH;
+    PublishPlan();
 }
 
 void VideoManager::MirrorVertical () {
-    mirrorV = !mirrorV;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.mirrorV = !settings.mirrorV;
+    PublishPlan();
 }
 
 void VideoManager::AdjustRotation (int value) {
-    rotation += value;
-    if (rotation < 0) {rotation += 360;}
-    if (rotation >= 360) {rotation -= 360;}
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    // Any multiple of a turn, either way, ends up in [0, 360)
+    settings.rotation = ((settings.rotation + value) % 360 + 360) % 360;
+    PublishPlan();
 }
 
 bool VideoManager::IsMaxZoomReached () {
@@ -38,133 +237,584 @@ bool VideoManager::IsMaxZoomReached () {
 }
 
 bool VideoManager::IsZoomInnactive () {
-    return zoomOut == 0;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    return settings.zoomOut == 0;
 }
 
 void VideoManager::ZoomOut () {
-    zoomOut += 1;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.zoomOut += 1;
+    PublishPlan();
 }
 
 void VideoManager::ZoomBackIn () {
-    zoomOut -= 1;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.zoomOut -= 1;
+    PublishPlan();
 }
 
 
 // Adjust color and filters
 void VideoManager::AdjustBrightness (int value) {
-    brightness = value;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.brightness = value;
+    PublishPlan();
 }
 
 void VideoManager::AdjustContrast (float value) {
-    contrast = value;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.contrast = value;
+    PublishPlan();
 }
 
 void VideoManager::AlterGreyscale () {
-    greyScale = !greyScale;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.greyScale = !settings.greyScale;
+    PublishPlan();
 }
 
 void VideoManager::AlterNegativeFilter () {
-    negativeFilter = !negativeFilter;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.negativeFilter = !settings.negativeFilter;
+    PublishPlan();
 }
 
 void VideoManager::AlterEdgeDetection () {
-    edgeDetection = !edgeDetection;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.edgeDetection = !settings.edgeDetection;
+    PublishPlan();
 }
 
 void VideoManager::AlterGradientFilter () {
-    gradientFilter = !gradientFilter;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.gradientFilter = !settings.gradientFilter;
+    PublishPlan();
+}
+
+
+void VideoManager::AlterAutoExposure () {
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.autoExposure = !settings.autoExposure;
+    PublishPlan();
+}
+
+ExposureStats VideoManager::GetExposureStats () {
+    return autoExposure.GetStats();
+}
+
+void VideoManager::SetTemporalMode (TemporalMode mode) {
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.temporalMode = mode;
+    PublishPlan();
+}
+
+void VideoManager::AdjustTemporalWindow (int frames) {
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.temporalWindow = std::max(1, std::min(frames, TEMPORAL_MAX_WINDOW));
+    PublishPlan();
+}
+
+void VideoManager::AdjustTemporalBlend (float value) {
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.temporalBlend = std::max(0.0f, std::min(value, 1.0f));
+    PublishPlan();
 }
 
 
 // Manage Gaussian filter application
 void VideoManager::ActivateGaussianFilter (int newKernelSize) {
-    if (!gaussianFilter) {gaussianFilter = true;}
-    gaussianKernelSize = newKernelSize;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    if (!settings.gaussianFilter) {settings.gaussianFilter = true;}
+    settings.gaussianKernelSize = newKernelSize;
+    PublishPlan();
 }
 
 void VideoManager::DeactivateGaussianFilter () {
-    gaussianFilter = false;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings.gaussianFilter = false;
+    PublishPlan();
 }
 
 
 // Reset changes to dafault values
 void VideoManager::Reset () {
-    rotation = 0,
-    zoomOut = 0,
-    brightness = 0;
-    contrast = 1;
-    maxZoom = false,
-    greyScale = false,
-    edgeDetection = false,
-    negativeFilter = false,
-    gaussianFilter = false,
-    gradientFilter = false,
-    mirrorH = false,
-    mirrorV = false;
+    std::lock_guard<std::mutex> lock(settingsMutex);
+    settings = FilterSettings();
+    maxZoom = false;
+    PublishPlan();
+}
+
+
+// Plan publication
+void VideoManager::PublishPlan () {
+    plans.emplace_back(new FilterPlan(settings, ++planGeneration));
+    const FilterPlan *newest = plans.back().get();
+    publishedPlan.store(newest);
+
+    // Free older plans, except the one UpdateFrame may still be running
+    const FilterPlan *inUse = planInUse.load();
+    plans.erase(std::remove_if(plans.begin(), plans.end(),
+        [newest, inUse](const std::unique_ptr<const FilterPlan> &plan) {
+            return plan.get() != newest && plan.get() != inUse;
+        }), plans.end());
+}
+
+const FilterPlan* VideoManager::AcquirePlan () {
+    // Announce the plan before using it, then make sure it wasn't replaced
+    // (and possibly freed) in between
+    const FilterPlan *plan = publishedPlan.load();
+    for (;;) {
+        planInUse.store(plan);
+        const FilterPlan *latest = publishedPlan.load();
+        if (latest == plan) {return plan;}
+        plan = latest;
+    }
 }
 
 
 // Apply current changes
 void VideoManager::UpdateFrame () {
+    StageTimer processTimer(profiler, Stage::Process);
 
-    // Mirror
-    if (mirrorH) {
-        flip(currentFrame, currentFrame, 1);
-    }
-    if (mirrorV) {
-        flip(currentFrame, currentFrame, 0);
-    }
+    // The plan stays the same for the whole frame, whatever the UI does
+    const FilterPlan *plan = AcquirePlan();
+    const FilterSettings &s = plan->settings;
 
-    // Apply current brightness and contrast values
-    currentFrame.convertTo(currentFrame, -1, contrast, brightness);
+    // Zoom levels that still leave a visible image
+    bool reachedMax;
+    GeometryTransform geometry;
+    geometry.mirrorH = s.mirrorH;
+    geometry.mirrorV = s.mirrorV;
+    geometry.rotation = s.rotation;
+    geometry.zoomLevels = GeometryTransform::ReachableZoomLevels(currentFrame.size(), s.zoomOut, reachedMax);
+    maxZoom = reachedMax;
 
-    // Apply filters
-    if (greyScale) {
-        cvtColor(currentFrame, currentFrame, COLOR_BGR2GRAY);
-        cvtColor(currentFrame, currentFrame, COLOR_GRAY2BGR);
-    }
-    if (negativeFilter) {
-        currentFrame.convertTo(currentFrame, -1, -1, 255);
-    }
-    if (gaussianFilter) {
-        GaussianBlur(currentFrame, currentFrame, Size(gaussianKernelSize, gaussianKernelSize), 0);
+    // Halvings the frame went through so far, which the Gaussian kernel follows
+    int gaussianScale = 0,
+        gaussianKernelSize = plan->GaussianKernelSize(0);
+    bool redimensioned = false;
+
+    // Last frame's outputs go back to the pool once the caller drops them.
+    // Every step reads currentFrame and writes a pooled buffer, which then
+    // becomes currentFrame: the frame given to SetFrame is never written.
+    redimentionedFrame.release();
+    Mat next;
+
+    // Proxy and degraded previews: halve the frame first, and take those
+    // halvings out of the zoom, or upscale the result back to the size it
+    // should have (a proxy's own size, at most)
+    QualityLevel quality = fullResolutionOutput ? QualityLevel::Full : previewQuality.load();
+    int proxyWidth = fullResolutionOutput ? 0 : previewProxyWidth.load(),
+        proxyLevels = 0;
+    while (proxyWidth > 0 && (currentFrame.cols >> (proxyLevels + 1)) >= proxyWidth) {proxyLevels++;}
+    int halvings = proxyLevels + (quality >= QualityLevel::HalfResolution ? 1 : 0);
+    while (halvings > 0 && ((currentFrame.cols >> halvings) < 1 || (currentFrame.rows >> halvings) < 1)) {halvings--;}
+    if (TracerOf(profiler)) {FrameTracer::SetFilters(TraceFilters(s, quality, incremental, proxyLevels > 0));}
+
+    GeometryTransform target = geometry;
+    target.zoomLevels = std::max(geometry.zoomLevels, proxyLevels);
+    Size outputSize = target.OutputSize(currentFrame.size());
+    bool upscale = halvings > target.zoomLevels;
+    if (halvings > 0) {
+        StageTimer timer(profiler, Stage::Geometry);
+        GeometryTransform shrink;
+        shrink.zoomLevels = halvings;
+        next = framePool.Acquire(shrink.OutputSize(currentFrame.size()), currentFrame.type());
+        shrink.Apply(currentFrame, next);
+        currentFrame = next;
+        gaussianScale += halvings;
+        gaussianKernelSize = plan->GaussianKernelSize(gaussianScale);
+        geometry.zoomLevels = std::max(0, geometry.zoomLevels - halvings);
     }
-    if (edgeDetection) {
-        cvtColor(currentFrame, currentFrame, COLOR_BGR2GRAY);
-        Canny(currentFrame, currentFrame, 50, 200);
-        cvtColor(currentFrame, currentFrame, COLOR_GRAY2BGR);
+    if (quality >= QualityLevel::SmallerGaussian) {
+        gaussianKernelSize = plan->GaussianKernelSize(++gaussianScale);
     }
-    if (gradientFilter) {
-        Mat gradX, gradY;
-        Sobel(currentFrame, gradX, CV_16S, 1, 0, 3);
-        Sobel(currentFrame, gradY, CV_16S, 0, 1, 3);
-        convertScaleAbs(gradX, gradX);
-        convertScaleAbs(gradY, gradY);
-        addWeighted(gradX, 0.5, gradY, 0.5, 0, currentFrame);
+
+    // Auto exposure measures the frame the steps are about to read; the
+    // result goes into the point operation tables, not a pass of its own
+    if (s.autoExposure) {
+        StageTimer timer(profiler, Stage::Exposure);
+        bool changed = autoExposure.Update(currentFrame);
+        if (changed || exposureLutGeneration != plan->generation) {
+            exposureLut.Build(autoExposure.Contrast(), autoExposure.Brightness(), s.negativeFilter, s.greyScale);
+            exposureLutGeneration = plan->generation;
+            exposureVersion++;
+        }
+    } else if (exposureLutGeneration != 0) {
+        autoExposure.Reset();           // Turned back on later, it starts from the scene then
+        exposureLutGeneration = 0;
     }
 
-    // Adjust rotation and dimensions
-    redimentionedFrame = currentFrame;
+    GradientBackend backend = gradientBackend;
+    const std::vector<PlanStep> &steps = fullResolutionOutput ? plan->fullResolutionSteps : plan->previewSteps;
+    bool cacheUsed = false;
+    for (size_t i = 0; i < steps.size(); i++) {
+        PlanStep step = steps[i];
+        Size size = currentFrame.size();
+        int type = currentFrame.type();
 
-    maxZoom = false;
-    for (int i=0; i<zoomOut;i++) {
-        resize(redimentionedFrame, redimentionedFrame, Size(), 0.5, 0.5);
-        if (redimentionedFrame.rows/2 == 0 || redimentionedFrame.cols/2 == 0) {
-            maxZoom = true;
+        // The first run of strip filters can reuse last frame's output, whatever
+        // came before it (temporal, geometry, Canny): its input is compared, not the capture
+        bool reuse = incremental && !cacheUsed && IsStripStep(step);
+        if ((stripPool || reuse) && IsStripStep(step)) {
+            // Every following step that can share the strips or tiles
+            std::vector<PlanStep> run;
+            for (; i < steps.size() && IsStripStep(steps[i]); i++) {
+                if (HaloRows(steps[i], gaussianKernelSize) > 0 || steps[i] != PlanStep::Gaussian) {
+                    run.push_back(steps[i]);
+                }
+            }
+            i--;
+            if (run.empty()) continue;
+            Segment segment(run, *plan, gaussianKernelSize, backend, type);
+            currentFrame = reuse ? RunIncremental(segment, currentFrame) : RunStrips(segment, currentFrame);
+            cacheUsed = cacheUsed || reuse;
+            RecordSegmentTimes(segment);
+            if (run.front() == PlanStep::Mirror) {
+                geometry.mirrorH = false;
+                geometry.mirrorV = false;
+            }
+            continue;
+        }
+
+        switch (step) {
+        case PlanStep::Temporal: {
+            // Needs every pixel of every frame in order, so never split into strips
+            StageTimer timer(profiler, Stage::Temporal);
+            next = framePool.Acquire(size, type);
+            temporalFilter.Apply(currentFrame, next, s.temporalMode, s.temporalWindow, s.temporalBlend);
+            currentFrame = next;
+            break;
+        }
+        case PlanStep::Mirror: {
+            // The full-resolution output is mirrored but not rotated or zoomed
+            StageTimer timer(profiler, Stage::Mirror);
+            int flipCode = s.mirrorH && s.mirrorV ? -1 : (s.mirrorH ? 1 : 0);
+            next = framePool.Acquire(size, type);
+            flip(currentFrame, next, flipCode);
+            currentFrame = next;
+            geometry.mirrorH = false;
+            geometry.mirrorV = false;
             break;
         }
+        case PlanStep::GeometryFirst: {
+            // Shrink first so the filters run on fewer pixels
+            StageTimer timer(profiler, Stage::Geometry);
+            next = framePool.Acquire(geometry.OutputSize(size), type);
+            geometry.Apply(currentFrame, next);
+            currentFrame = next;
+            // Same blur as the full-resolution kernel would give after zooming out
+            if (geometry.zoomLevels > 0) {
+                gaussianScale += geometry.zoomLevels;
+                gaussianKernelSize = plan->GaussianKernelSize(gaussianScale);
+            }
+            break;
+        }
+        case PlanStep::PointOps: {
+            // Brightness, contrast, greyscale and negative in a single pass
+            StageTimer timer(profiler, Stage::PointOps);
+            next = framePool.Acquire(size, plan->OutputType(step, type));
+            ApplyFilter(step, *plan, gaussianKernelSize, backend, currentFrame, next);
+            currentFrame = next;
+            break;
+        }
+        case PlanStep::Gaussian: {
+            if (gaussianKernelSize <= 1) break;
+            StageTimer timer(profiler, Stage::Gaussian);
+            next = framePool.Acquire(size, type);
+            ApplyFilter(step, *plan, gaussianKernelSize, backend, currentFrame, next);
+            currentFrame = next;
+            break;
+        }
+        case PlanStep::EdgeDetection: {
+            // (Canny still allocates its own scratch buffers)
+            StageTimer timer(profiler, Stage::EdgeDetection);
+            Mat grey = currentFrame;
+            if (currentFrame.channels() != 1) {
+                grey = framePool.Acquire(size, CV_8UC1);
+                cvtColor(currentFrame, grey, COLOR_BGR2GRAY);
+            }
+            next = framePool.Acquire(size, CV_8UC1);
+            Canny(grey, next, 50, 200);
+            currentFrame = next;
+            break;
+        }
+        case PlanStep::Gradient: {
+            StageTimer timer(profiler, Stage::Gradient);
+            next = framePool.Acquire(size, type);
+            ApplyFilter(step, *plan, gaussianKernelSize, backend, currentFrame, next);
+            currentFrame = next;
+            break;
+        }
+        case PlanStep::GeometryLast: {
+            // Adjust rotation and dimensions
+            StageTimer timer(profiler, Stage::Geometry);
+            redimentionedFrame = framePool.Acquire(geometry.OutputSize(size), type);
+            geometry.Apply(currentFrame, redimentionedFrame);
+            redimensioned = true;
+            break;
+        }
+        }
+    }
+    if (incremental && !cacheUsed) {incrementalUncovered++;}
+
+    if (!redimensioned) {
+        redimentionedFrame = currentFrame;
+    }
+
+    if (upscale && redimentionedFrame.size() != outputSize) {
+        StageTimer timer(profiler, Stage::Geometry);
+        next = framePool.Acquire(outputSize, redimentionedFrame.type());
+        resize(redimentionedFrame, next, outputSize, 0, 0, INTER_LINEAR);
+        redimentionedFrame = next;
+        currentFrame = next;
     }
-    switch (rotation) {
-    case 90:
-        rotate(redimentionedFrame, redimentionedFrame, ROTATE_90_CLOCKWISE);
+}
+
+
+// Filters shared by the full-frame and strip paths
+void VideoManager::ApplyFilter (PlanStep step, const FilterPlan &plan, int gaussianKernelSize,
+                                GradientBackend backend, const Mat &src, Mat &dst) {
+    const FilterSettings &s = plan.settings;
+    Size size = src.size();
+    int type = src.type();
+    switch (step) {
+    case PlanStep::PointOps:
+        if (type == CV_8UC3 || type == CV_8UC1) {
+            (s.autoExposure ? exposureLut : plan.pointLut).Apply(src, dst);
+        } else {
+            if (s.autoExposure) {
+                src.convertTo(dst, -1, autoExposure.Contrast(), autoExposure.Brightness());
+            } else {
+                src.convertTo(dst, -1, s.contrast, s.brightness);
+            }
+            if (s.greyScale) {
+                cvtColor(dst, dst, COLOR_BGR2GRAY);
+                cvtColor(dst, dst, COLOR_GRAY2BGR);
+            }
+            if (s.negativeFilter) {
+                dst.convertTo(dst, -1, -1, 255);
+            }
+        }
         break;
-    case 180:
-        rotate(redimentionedFrame, redimentionedFrame, ROTATE_180);
+    case PlanStep::Gaussian:
+        // Specialized for the slider's kernel sizes, GaussianBlur for others
+        FixedGaussian::Apply(src, dst, gaussianKernelSize);
         break;
-    case 270:
-        rotate(redimentionedFrame, redimentionedFrame, ROTATE_90_COUNTERCLOCKWISE);
+    case PlanStep::Gradient:
+        if (backend == GradientBackend::OpenCV) {
+            // Intermediates shaped like the buffer src is part of (the frame or
+            // a scratch buffer), so regions of any size don't add pool shapes
+            int channels = src.channels();
+            Size whole;
+            Point offset;
+            src.locateROI(whole, offset);
+            Rect area(0, 0, size.width, size.height);
+            Mat gradX = framePool.Acquire(whole, CV_MAKETYPE(CV_16S, channels))(area),
+                gradY = framePool.Acquire(whole, CV_MAKETYPE(CV_16S, channels))(area),
+                absX = framePool.Acquire(whole, CV_MAKETYPE(CV_8U, channels))(area),
+                absY = framePool.Acquire(whole, CV_MAKETYPE(CV_8U, channels))(area);
+            Sobel(src, gradX, CV_16S, 1, 0, 3, 1, 0, BORDER_DEFAULT | BORDER_ISOLATED);
+            Sobel(src, gradY, CV_16S, 0, 1, 3, 1, 0, BORDER_DEFAULT | BORDER_ISOLATED);
+            convertScaleAbs(gradX, absX);
+            convertScaleAbs(gradY, absY);
+            addWeighted(absX, 0.5, absY, 0.5, 0, dst);
+        } else {
+            // Same result in one pass, without the 16-bit images
+            GradientMagnitude::Apply(src, dst, backend);
+        }
         break;
     default:
+        src.copyTo(dst);
         break;
     }
 }
+
+void VideoManager::RunRegion (Segment &segment, const Mat &src, Rect region, Mat &dst) {
+    const FilterSettings &s = segment.plan->settings;
+    const std::vector<PlanStep> &steps = segment.steps;
+    Rect frame(0, 0, src.cols, src.rows);
+
+    // Pixels each step has to produce, working back from the region:
+    // needed[k] is the input of step k, needed.back() the region itself
+    std::vector<Rect> needed(steps.size() + 1);
+    needed.back() = region;
+    for (int k = (int)steps.size() - 1; k >= 0; k--) {
+        int halo = HaloRows(steps[k], segment.gaussianKernelSize);
+        Rect grown(needed[k + 1].x - halo, needed[k + 1].y - halo,
+                   needed[k + 1].width + 2*halo, needed[k + 1].height + 2*halo);
+        needed[k] = grown & frame;
+    }
+
+    // (Mirror, when present, is the first step and reads src directly)
+    FrameTracer *tracer = TracerOf(profiler);
+    std::vector<Mat> scratch = segment.TakeScratch(framePool, src.size());
+    Mat input = src(needed[0]);
+    for (size_t k = 0; k < steps.size(); k++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Mat output = scratch[k](Rect(0, 0, needed[k].width, needed[k].height));
+        if (steps[k] == PlanStep::Mirror) {
+            // Pixels of the mirrored frame come from the other side of the source
+            int flipCode = s.mirrorH && s.mirrorV ? -1 : (s.mirrorH ? 1 : 0);
+            Rect source = needed[k];
+            if (s.mirrorH) {source.x = src.cols - needed[k].x - needed[k].width;}
+            if (s.mirrorV) {source.y = src.rows - needed[k].y - needed[k].height;}
+            flip(src(source), output, flipCode);
+        } else {
+            ApplyFilter(steps[k], *segment.plan, segment.gaussianKernelSize, segment.backend, input, output);
+        }
+        // Pixels next to a cut inside the frame saw made-up neighbours; drop them
+        input = output(Rect(needed[k + 1].x - needed[k].x, needed[k + 1].y - needed[k].y,
+                            needed[k + 1].width, needed[k + 1].height));
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::micro> elapsed = end - start;
+        segment.microseconds[k] += (long long)elapsed.count();
+        if (tracer) {tracer->Record(StageProfiler::StageName(StageOf(steps[k])), start, end);}
+    }
+    input.copyTo(dst(region));
+    segment.ReturnScratch(std::move(scratch));
+}
+
+void VideoManager::RecordSegmentTimes (Segment &segment) {
+    if (!profiler) {return;}
+    for (size_t k = 0; k < segment.steps.size(); k++) {
+        profiler->Record(StageOf(segment.steps[k]), segment.microseconds[k] / 1000.0);
+    }
+}
+
+Mat VideoManager::RunStrips (Segment &segment, const Mat &src) {
+    int width = src.cols,
+        height = src.rows;
+    Mat dst = framePool.Acquire(src.size(), segment.types.back());
+    if (!stripPool) {
+        segment.SetRegionRows(height);
+        RunRegion(segment, src, Rect(0, 0, width, height), dst);
+        return dst;
+    }
+
+    int rows = stripRows;
+    if (rows <= 0) {
+        int threads = (int)stripPool->Size();
+        rows = std::max(MIN_STRIP_ROWS, STRIP_TARGET_BYTES / std::max(1, (int)(width*CV_ELEM_SIZE(segment.types[0]))));
+        rows = std::min(rows, std::max(MIN_STRIP_ROWS, height / (threads*STRIPS_PER_THREAD)));
+    }
+    int strips = (height + rows - 1) / rows;
+    segment.SetRegionRows(std::min(rows, height));
+    FrameTracer::Context context = FrameTracer::CurrentContext();   // Strip spans belong to this frame too
+    stripPool->ParallelFor(strips, [&](int strip) {
+        FrameTracer::SetContext(context);
+        int top = strip*rows;
+        RunRegion(segment, src, Rect(0, top, width, std::min(rows, height - top)), dst);
+    });
+    return dst;
+}
+
+Mat VideoManager::RunIncremental (Segment &segment, const Mat &src) {
+    int width = src.cols,
+        height = src.rows,
+        tilesX = (width + INCREMENTAL_TILE - 1) / INCREMENTAL_TILE,
+        tilesY = (height + INCREMENTAL_TILE - 1) / INCREMENTAL_TILE,
+        tiles = tilesX*tilesY;
+    auto tileRect = [width, height](int tx, int ty) {
+        return Rect(tx*INCREMENTAL_TILE, ty*INCREMENTAL_TILE,
+                    std::min(INCREMENTAL_TILE, width - tx*INCREMENTAL_TILE),
+                    std::min(INCREMENTAL_TILE, height - ty*INCREMENTAL_TILE));
+    };
+    incrementalFrames++;
+    incrementalTiles += tiles;
+
+    // Anything computed for other settings, another size or the other set of steps is useless
+    bool reusable = cachedGeneration == segment.plan->generation
+                 && cachedExposureVersion == exposureVersion
+                 && cachedFullResolution == fullResolutionOutput
+                 && cachedGaussianKernelSize == segment.gaussianKernelSize
+                 && referenceInput.size() == src.size() && referenceInput.type() == src.type()
+                 && cachedOutput.type() == segment.types.back();
+    if (!reusable) {
+        src.copyTo(referenceInput);
+        cachedOutput = RunStrips(segment, src);
+        cachedGeneration = segment.plan->generation;
+        cachedExposureVersion = exposureVersion;
+        cachedFullResolution = fullResolutionOutput;
+        cachedGaussianKernelSize = segment.gaussianKernelSize;
+        return cachedOutput;
+    }
+
+    // 1. Input tiles that moved away from what their cached output was computed
+    //    from (not from the last capture, so slow drifts add up and get caught)
+    double tolerance = incrementalTolerance;
+    std::vector<uchar> changed(tiles);
+    parallel_for_(Range(0, tiles), [&](const Range &range) {
+        for (int t = range.start; t < range.end; t++) {
+            Rect rect = tileRect(t % tilesX, t / tilesX);
+            double sad = norm(src(rect), referenceInput(rect), NORM_L1);
+            changed[t] = sad > tolerance*rect.area()*src.channels();
+        }
+    });
+
+    // 2. Output tiles with a changed tile anywhere in their input, halo included
+    const FilterSettings &s = segment.plan->settings;
+    bool mirror = segment.steps.front() == PlanStep::Mirror;
+    std::vector<uchar> dirty(tiles);
+    int dirtyCount = 0;
+    for (int t = 0; t < tiles; t++) {
+        Rect input = tileRect(t % tilesX, t / tilesX);
+        if (mirror && s.mirrorH) {input.x = width - input.x - input.width;}
+        if (mirror && s.mirrorV) {input.y = height - input.y - input.height;}
+        input = Rect(input.x - segment.halo, input.y - segment.halo,
+                     input.width + 2*segment.halo, input.height + 2*segment.halo) & Rect(0, 0, width, height);
+        int x0 = input.x / INCREMENTAL_TILE, x1 = (input.x + input.width - 1) / INCREMENTAL_TILE,
+            y0 = input.y / INCREMENTAL_TILE, y1 = (input.y + input.height - 1) / INCREMENTAL_TILE;
+        for (int ty = y0; ty <= y1 && !dirty[t]; ty++) {
+            for (int tx = x0; tx <= x1; tx++) {
+                if (changed[ty*tilesX + tx]) {
+                    dirty[t] = 1;
+                    break;
+                }
+            }
+        }
+        dirtyCount += dirty[t];
+    }
+    incrementalReused += tiles - dirtyCount;
+    if (dirtyCount == 0) {return cachedOutput;}    // Nothing to do, not even a copy
+
+    // 3. Recompute dirty tiles, merged into horizontal runs to share halos,
+    //    and copy the others from the cached output
+    Mat dst = framePool.Acquire(src.size(), segment.types.back());
+    std::vector<Rect> runs;
+    for (int ty = 0; ty < tilesY; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            int t = ty*tilesX + tx;
+            if (!dirty[t]) {
+                Rect rect = tileRect(tx, ty);
+                cachedOutput(rect).copyTo(dst(rect));
+            } else if (tx > 0 && dirty[t - 1]) {
+                runs.back().width += tileRect(tx, ty).width;
+            } else {
+                runs.push_back(tileRect(tx, ty));
+            }
+        }
+    }
+    segment.SetRegionRows(std::min(INCREMENTAL_TILE, height));    // Runs never span two tile rows
+    FrameTracer::Context context = FrameTracer::CurrentContext();
+    auto runOne = [&](int r) {
+        FrameTracer::SetContext(context);
+        RunRegion(segment, src, runs[r], dst);
+    };
+    if (stripPool) {
+        stripPool->ParallelFor((int)runs.size(), runOne);
+    } else {
+        parallel_for_(Range(0, (int)runs.size()), [&](const Range &range) {
+            for (int r = range.start; r < range.end; r++) {runOne(r);}
+        });
+    }
+
+    // 4. The reference follows the input only where it changed
+    for (int t = 0; t < tiles; t++) {
+        if (!changed[t]) continue;
+        Rect rect = tileRect(t % tilesX, t / tilesX);
+        src(rect).copyTo(referenceInput(rect));
+    }
+    cachedOutput = dst;
+    return dst;
+}
@@ -2,31 +2,164 @@
 #define VIDEOMANAGER_HPP
 
 #include <opencv2/opencv.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "AutoExposure.hpp"
+#include "FilterPlan.hpp"
+#include "FramePool.hpp"
+#include "GeometryTransform.hpp"
+#include "GradientMagnitude.hpp"
+#include "QualityScheduler.hpp"
+#include "StageProfiler.hpp"
+#include "TemporalFilter.hpp"
+#include "WorkStealingPool.hpp"
+
+struct IncrementalStats {
+    long long frames = 0,           // Frames that went through incremental mode
+              tiles = 0,
+              reusedTiles = 0,      // Copied from the previous output instead of computed
+              uncoveredFrames = 0;  // Processed in full: no filter of the plan is covered
+    double hitRate = 0;
+};
 
 class VideoManager {
     private:
+        struct Segment;
+
         cv::Mat currentFrame,
                 redimentionedFrame;
-        int rotation = 0,
-            zoomOut = 0,
-            gaussianKernelSize = 3,
-            brightness = 0;
-        float contrast = 1;
-        bool maxZoom = false,
-            mirrorH = false,
-            mirrorV = false,
-            greyScale = false,
-            edgeDetection = false,
-            negativeFilter = false,
-            gradientFilter = false,
-            gaussianFilter = false;
+
+        // Settings are changed by the UI thread, which compiles them into a
+        // new FilterPlan after every change and publishes it atomically.
+        // UpdateFrame picks up the latest plan once per frame without locking.
+        FilterSettings settings;
+        std::mutex settingsMutex;       // Only between setters
+        std::vector<std::unique_ptr<const FilterPlan>> plans;
+        std::atomic<const FilterPlan*> publishedPlan {nullptr},
+                                       planInUse {nullptr};     // Hazard pointer of UpdateFrame
+        uint64_t planGeneration = 0;
+
+        FramePool framePool;            // Every intermediate and output frame
+        StageProfiler *profiler = nullptr;
+        bool fullResolutionOutput = true;
+        std::atomic<GradientBackend> gradientBackend;
+        WorkStealingPool *stripPool = nullptr;
+        int stripRows = 0;
+        std::atomic<QualityLevel> previewQuality {QualityLevel::Full};
+        std::atomic<int> previewProxyWidth {0};
+
+        // Incremental mode: the output of the filters reading the captured frame
+        // is cached, along with the input each part of it was computed from
+        std::atomic<bool> incremental {false};
+        std::atomic<double> incrementalTolerance {0};
+        cv::Mat referenceInput,
+                cachedOutput;
+        uint64_t cachedGeneration = 0,      // Plan the cache was computed with (0: none)
+                 cachedExposureVersion = 0;
+        bool cachedFullResolution = false;
+        int cachedGaussianKernelSize = 0;
+        std::atomic<long long> incrementalFrames {0},
+                               incrementalTiles {0},
+                               incrementalReused {0},
+                               incrementalUncovered {0};
+        std::atomic<bool> maxZoom {false};
+
+        // Frames the temporal filters remember (it starts over whenever the
+        // frame size changes, e.g. between recorded and proxy frames)
+        TemporalFilter temporalFilter;
+
+        // Auto exposure: point operation tables rebuilt whenever the
+        // measured brightness or contrast moves, used instead of the plan's
+        AutoExposure autoExposure;
+        PointLut exposureLut;
+        uint64_t exposureLutGeneration = 0,     // Plan the tables were built for
+                 exposureVersion = 0;           // Grows with every rebuild
+
+        // Compile the current settings (settingsMutex held)
+        void PublishPlan();
+        // Latest plan, protected from deletion until the next call
+        const FilterPlan* AcquirePlan();
+
+        // Point or neighbourhood filter from src into dst (same shape); rows
+        // beyond src's edges are always extrapolated, never read from a parent Mat
+        void ApplyFilter(PlanStep step, const FilterPlan &plan, int gaussianKernelSize,
+                         GradientBackend backend, const cv::Mat &src, cv::Mat &dst);
+        // Every step of a segment on one region of the frame (plus the context it needs)
+        void RunRegion(Segment &segment, const cv::Mat &src, cv::Rect region, cv::Mat &dst);
+        // The whole frame, strip by strip on the pool if there is one
+        cv::Mat RunStrips(Segment &segment, const cv::Mat &src);
+        // Only the tiles whose input changed since they were last computed
+        cv::Mat RunIncremental(Segment &segment, const cv::Mat &src);
+        void RecordSegmentTimes(Segment &segment);
 
     public:
+        VideoManager();
+        ~VideoManager();
+
         // Frame getters + setters
+        // UpdateFrame never writes into the frame given to SetFrame; with no
+        // active step, GetCurrentFrame returns that same frame.
+        // After greyscale or edge detection, frames are single-channel (CV_8UC1):
+        // sinks that need BGR expand them with cvtColor(..., COLOR_GRAY2BGR).
         cv::Mat GetCurrentFrame();
         cv::Mat GetRedimensionedFrame();
         void SetFrame(cv::Mat frame);
 
+        // Buffers UpdateFrame draws from (also usable by the caller)
+        FramePool& GetFramePool();
+
+        // Report stage timings to a profiler (none by default)
+        void SetProfiler(StageProfiler *profiler);
+
+        // When off, only the redimensioned frame is needed: zoom out and
+        // rotation are then applied before the filters, on fewer pixels,
+        // and GetCurrentFrame returns the same frame as GetRedimensionedFrame.
+        // Set from the thread calling UpdateFrame.
+        void SetFullResolutionOutput(bool enabled);
+
+        // Cheaper previews under load: from QualityLevel::HalfResolution on,
+        // the filters run on a frame half the size, upscaled back at the end
+        // (or zoomed out one level less); from SmallerGaussian on, the blur
+        // kernel is halved too. Frames with full-resolution output are never
+        // degraded. Skipping frames is up to the caller. Thread-safe.
+        void SetPreviewQuality(QualityLevel level);
+
+        // Dual resolution: frames without full-resolution output are halved
+        // as long as they stay at least width pixels wide, filtered at that
+        // size, and left that small (zoom out shrinks them further only past
+        // it); displays scale them up. Frames with full-resolution output,
+        // the recorded ones, keep every pixel. Zero turns it off. Thread-safe.
+        void SetPreviewProxy(int width);
+
+        // Gradient filter implementation (the fastest one by default)
+        void SetGradientBackend(GradientBackend backend);
+
+        // With a pool, runs of mirror, point operations, Gaussian and gradient
+        // are done in horizontal strips (plus the halo rows the filters need)
+        // spread over the pool, while each strip is still in cache. Output is
+        // the same; per-filter timings are then CPU time summed over the
+        // strips rather than wall time. Zero rows picks a strip height from
+        // the frame width. While any manager has a pool, OpenCV runs on one
+        // thread (cv::setNumThreads(1)), so strips don't each start their
+        // own; the other steps then run on the calling thread only. Set from
+        // the thread calling UpdateFrame.
+        void SetStripExecution(WorkStealingPool *pool, int rows = 0);
+
+        // Reuse last frame's output where the captured frame did not change:
+        // frames are compared in 64x64 tiles, and a tile is recomputed when
+        // its input (including the filters' halo) differs by more than
+        // tolerance per sample on average. Zero tolerance gives the exact
+        // output. The first run of mirror, point operations, Gaussian and
+        // gradient in the plan is covered, after temporal filters or a
+        // preview's early shrink too (their output is what gets compared);
+        // filters after Canny or a second run are always computed. A plan
+        // with none of them shows up in uncoveredFrames. Any setter starts
+        // over. Thread-safe.
+        void SetIncrementalMode(bool enabled, double tolerance = 0);
+        IncrementalStats GetIncrementalStats();
+
         // Adjust size, reflection and rotation
         void MirrorHorizontal();
         void MirrorVertical();
@@ -44,6 +177,19 @@ class VideoManager {
         void AlterEdgeDetection();
         void AlterGradientFilter();
 
+        // Set brightness and contrast from each frame's histogram (the
+        // sliders' values are ignored meanwhile); GetExposureStats tells
+        // what was measured and applied. Thread-safe.
+        void AlterAutoExposure();
+        ExposureStats GetExposureStats();
+
+        // Filters over the last frames: denoise, motion trail or motion
+        // highlight; window is in frames (1 to TEMPORAL_MAX_WINDOW) and
+        // blend between 0 and 1 (see TemporalFilter)
+        void SetTemporalMode(TemporalMode mode);
+        void AdjustTemporalWindow(int frames);
+        void AdjustTemporalBlend(float value);
+
         // Manage Gaussian filter application
         void ActivateGaussianFilter(int newKernelSize);
         void DeactivateGaussianFilter();
@@ -51,7 +197,7 @@ class VideoManager {
         // Reset changes to dafault values
         void Reset();
 
-        // Apply current changes
+        // Apply current changes (one thread at a time)
         void UpdateFrame();
 };
 
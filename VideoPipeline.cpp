@@ -0,0 +1,138 @@
+#include "VideoPipeline.hpp"
+#include <iostream>
+#include <opencv2/opencv.hpp>
+using namespace cv;
+
+VideoPipeline::VideoPipeline (FrameSource &source, VideoManager &videoManager,
+                              std::atomic<bool> &recording, PipelineConfig config)
+    : source(source),
+      videoManager(videoManager),
+      recording(recording),
+      config(config),
+      processQueue(config.processCapacity, config.processPolicy),
+      displayQueue(config.displayCapacity, config.displayPolicy),
+      recorder(config.recorder),
+      scheduler(config.quality),
+      preRecord(config.recorder.preRecordSeconds > 0) {
+    recorder.SetProfiler(config.profiler);
+}
+
+VideoPipeline::~VideoPipeline () {
+    Stop();
+}
+
+
+// Start or stop every stage thread
+void VideoPipeline::Start () {
+    if (running) {return;}
+    running = true;
+    processThread = std::thread(&VideoPipeline::ProcessLoop, this);
+    captureThread = std::thread(&VideoPipeline::CaptureLoop, this);
+}
+
+void VideoPipeline::Stop () {
+    running = false;
+    processQueue.Close();
+    if (captureThread.joinable()) {captureThread.join();}
+    if (processThread.joinable()) {processThread.join();}
+    recorder.Stop();
+    recorder.WaitForFlush();
+}
+
+
+// Stage 1: grab frames from the source
+void VideoPipeline::CaptureLoop () {
+    FrameTracer::NameThread("capture");
+    while (running) {
+        FramePacket packet;
+        bool read;
+        FrameTracer::SetFrame(captured);
+        {
+            StageTimer timer(config.profiler, Stage::Capture);
+            read = source.Read(packet.original);
+        }
+        packet.captureTime = std::chrono::steady_clock::now();
+        if (!read) break;                       // End video stream if nothing was captured
+        packet.index = captured++;
+        if (!processQueue.Push(std::move(packet))) break;
+    }
+    processQueue.Close();
+}
+
+// Stage 2: apply the VideoManager filters and hand frames to the recorder
+void VideoPipeline::ProcessLoop () {
+    FrameTracer::NameThread("process");
+    FramePacket packet;
+    while (processQueue.Pop(packet)) {
+        FrameTracer::SetFrame(packet.index);
+        // Full resolution is only needed when the frame gets recorded
+        packet.record = recording;
+        // With pre-record, any frame may end up in a recording
+        bool fullQuality = packet.record || preRecord;
+        if (!fullQuality) {
+            // Under heavy load, every other preview frame is dropped unprocessed
+            if (scheduler.ShouldSkip()) continue;
+            packet.quality = scheduler.Level();
+        }
+        videoManager.SetFullResolutionOutput(fullQuality);
+        videoManager.SetPreviewQuality(packet.quality);
+        videoManager.SetFrame(packet.original);     // Only read, so display still gets the original
+        auto start = std::chrono::steady_clock::now();
+        videoManager.UpdateFrame();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        packet.edited = videoManager.GetCurrentFrame();
+        packet.redimensioned = videoManager.GetRedimensionedFrame();
+        processed++;
+
+        // Only previews are measured: recorded frames are never degraded
+        if (!fullQuality) {scheduler.Update(ms);}
+
+        // A file that can't be written (full disk) ends the recording for good
+        if (!recordFailed && recorder.HasWriteFailed()) {
+            std::cout << "Failed to write video file" << std::endl;
+            recordFailed = true;
+        }
+        if (packet.record && !recordFailed) {
+            // Configure new video
+            if (!recorder.IsRecording() && !recorder.Start(config.outputFile, packet.edited.size(), config.fps, packet.edited.type())) {
+                std::cout << "Failed to open video file" << std::endl;
+                recordFailed = true;
+            }
+            // Register frame (encoded and written by the recorder's threads)
+            if (!recordFailed) {recorder.Submit(packet.edited, packet.captureTime);}
+        } else if (!packet.record) {
+            // Save recording in progress, without waiting for it
+            if (recorder.IsRecording()) {recorder.Stop();}
+            // History for the next recording
+            if (preRecord) {recorder.Buffer(packet.edited, packet.captureTime);}
+        }
+
+        displayQueue.Push(std::move(packet));
+    }
+    displayQueue.Close();
+}
+
+
+// Display side (called from the GUI thread)
+bool VideoPipeline::PopDisplayFrame (FramePacket &packet) {
+    return displayQueue.TryPop(packet);
+}
+
+bool VideoPipeline::IsFinished () {
+    return displayQueue.IsClosed() && displayQueue.GetStats().depth == 0;
+}
+
+bool VideoPipeline::HasRecordingFailed () {
+    return recordFailed;
+}
+
+PipelineStats VideoPipeline::GetStats () {
+    PipelineStats stats;
+    stats.process = processQueue.GetStats();
+    stats.display = displayQueue.GetStats();
+    stats.recorder = recorder.GetStats();
+    stats.quality = scheduler.GetStats();
+    stats.captured = captured;
+    stats.processed = processed;
+    return stats;
+}
@@ -0,0 +1,98 @@
+#ifndef VIDEOPIPELINE_HPP
+#define VIDEOPIPELINE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "AsyncRecorder.hpp"
+#include "FrameQueue.hpp"
+#include "FrameSource.hpp"
+#include "QualityScheduler.hpp"
+#include "StageProfiler.hpp"
+#include "VideoManager.hpp"
+
+// Everything a frame carries between stages
+struct FramePacket {
+    cv::Mat original,
+            edited,
+            redimensioned;
+    long long index = 0;
+    bool record = false;
+    QualityLevel quality = QualityLevel::Full;     // Recorded frames are always Full
+    std::chrono::steady_clock::time_point captureTime;
+};
+
+// Input queue of each stage: capacity and what to do when it is full
+struct PipelineConfig {
+    size_t processCapacity = 4,
+           displayCapacity = 2;
+    QueuePolicy processPolicy = QueuePolicy::DropOldest,
+                displayPolicy = QueuePolicy::DropOldest;
+    RecorderConfig recorder;                // Encoder threads, back-pressure and pre-record
+    QualityConfig quality;                  // Preview degradation under load
+    int fps = 30;
+    std::string outputFile = "DuckyVideo.avi";
+    StageProfiler *profiler = nullptr;      // Optional stage timings
+};
+
+struct PipelineStats {
+    QueueStats process,
+               display;
+    RecorderStats recorder;
+    QualityStats quality;
+    long long captured = 0,
+              processed = 0;
+};
+
+// Runs capture and processing on their own threads, and hands recorded
+// frames to an AsyncRecorder that encodes them in parallel. Display stays
+// on the caller's (GUI) thread, which pulls finished frames with
+// PopDisplayFrame() in between Qt event processing. When processing a
+// preview frame takes longer than the deadline, a QualityScheduler makes
+// previews cheaper; recorded frames keep full quality. With pre-record on,
+// every frame is processed at full quality and kept by the recorder, so a
+// recording starts with the last seconds before the button was pressed.
+class VideoPipeline {
+    private:
+        FrameSource &source;
+        VideoManager &videoManager;
+        std::atomic<bool> &recording;
+        PipelineConfig config;
+
+        FrameQueue<FramePacket> processQueue,
+                                displayQueue;
+        AsyncRecorder recorder;
+        QualityScheduler scheduler;
+        bool preRecord;                     // Frames are buffered, so all get full quality
+        std::thread captureThread,
+                    processThread;
+        std::atomic<bool> running {false},
+                          recordFailed {false};
+        std::atomic<long long> captured {0},
+                               processed {0};
+
+        void CaptureLoop();
+        void ProcessLoop();
+
+    public:
+        VideoPipeline(FrameSource &source, VideoManager &videoManager,
+                      std::atomic<bool> &recording, PipelineConfig config = PipelineConfig());
+        ~VideoPipeline();
+
+        // Start or stop every stage thread (Stop also waits for the recording to be saved)
+        void Start();
+        void Stop();
+
+        // Get the next frame ready for display (non-blocking)
+        bool PopDisplayFrame(FramePacket &packet);
+
+        // True once the capture ended and every queued frame was displayed
+        bool IsFinished();
+        bool HasRecordingFailed();
+
+        PipelineStats GetStats();
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "WorkStealingPool.hpp"
+#include "FrameTracer.hpp"
+#include <iterator>
+#include <string>
+
+// Index passed to TryRun by threads that are not workers
+#define NO_WORKER ((size_t)-1)
+
+WorkStealingPool::WorkStealingPool (size_t threads) {
+    if (threads == 0) {threads = std::thread::hardware_concurrency();}
+    if (threads == 0) {threads = 1;}
+    for (size_t i = 0; i < threads; i++) {
+        queues.emplace_back(new Worker());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        this->threads.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool () {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread : threads) {thread.join();}
+}
+
+size_t WorkStealingPool::Size () {
+    return queues.size();
+}
+
+uint64_t WorkStealingPool::Executed () {
+    return executed;
+}
+
+uint64_t WorkStealingPool::Stolen () {
+    return stolen;
+}
+
+
+// Queueing
+void WorkStealingPool::Push (size_t queue, std::function<void()> task, const void *group) {
+    {
+        std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+        queues[queue]->tasks.push_back({std::move(task), group});
+    }
+    queued++;
+    {
+        // Pairs with the predicate check in WorkerLoop, so no wake-up is lost
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+void WorkStealingPool::Submit (std::function<void()> task) {
+    Push(nextQueue++ % queues.size(), std::move(task));
+}
+
+void WorkStealingPool::ParallelFor (int count, const std::function<void(int)> &body) {
+    if (count <= 0) {return;}
+    std::atomic<int> remaining {count};
+    size_t workers = queues.size();
+    for (size_t w = 0; w < workers; w++) {
+        int begin = (int)(count*w / workers),
+            end = (int)(count*(w + 1) / workers);
+        for (int i = begin; i < end; i++) {
+            Push(w, [&body, &remaining, i]() {
+                body(i);
+                remaining--;
+            }, &remaining);
+        }
+    }
+
+    // Help instead of just waiting (this also makes nested calls safe)
+    while (remaining > 0) {
+        if (!TryRun(NO_WORKER, &remaining)) {std::this_thread::yield();}
+    }
+}
+
+
+// Worker side
+bool WorkStealingPool::TryRun (size_t self, const void *group) {
+    std::function<void()> task;
+    size_t workers = queues.size();
+
+    if (self != NO_WORKER) {
+        Worker &own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front().run);
+            own.tasks.pop_front();
+        }
+    }
+
+    // Steal from the back, away from where the owner is working
+    for (size_t k = 1; !task && k <= workers; k++) {
+        size_t victim = self == NO_WORKER ? k - 1 : (self + k) % workers;
+        if (victim == self) continue;
+        Worker &other = *queues[victim];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        for (auto it = other.tasks.rbegin(); it != other.tasks.rend(); ++it) {
+            if (group && it->group != group) continue;
+            task = std::move(it->run);
+            other.tasks.erase(std::next(it).base());
+            stolen++;
+            break;
+        }
+    }
+
+    if (!task) {return false;}
+    queued--;
+    // A helping thread goes back to its own frame's spans afterwards
+    FrameTracer::Context context = FrameTracer::CurrentContext();
+    task();
+    FrameTracer::SetContext(context);
+    executed++;
+    return true;
+}
+
+void WorkStealingPool::WorkerLoop (size_t index) {
+    FrameTracer::NameThread("worker " + std::to_string(index));
+    for (;;) {
+        if (TryRun(index)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() {return stopping || queued > 0;});
+        if (stopping && queued == 0) {return;}
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef WORKSTEALINGPOOL_HPP
+#define WORKSTEALINGPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads with a task deque each. A worker runs its own tasks in
+// order and, once out of work, steals from the far end of another
+// worker's deque, so uneven tasks still keep every core busy.
+class WorkStealingPool {
+    private:
+        struct Task {
+            std::function<void()> run;
+            const void *group;          // The ParallelFor call it belongs to, if any
+        };
+
+        struct Worker {
+            std::deque<Task> tasks;
+            std::mutex mutex;
+        };
+
+        std::vector<std::unique_ptr<Worker>> queues;
+        std::vector<std::thread> threads;
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        std::atomic<size_t> queued {0},
+                            nextQueue {0};
+        std::atomic<uint64_t> executed {0},
+                              stolen {0};
+        std::atomic<bool> stopping {false};
+
+        void Push(size_t queue, std::function<void()> task, const void *group = nullptr);
+        // With a group, only that group's tasks are taken
+        bool TryRun(size_t self, const void *group = nullptr);
+        void WorkerLoop(size_t index);
+
+    public:
+        // Zero threads means one per hardware core
+        explicit WorkStealingPool(size_t threads = 0);
+        ~WorkStealingPool();
+
+        size_t Size();
+        void Submit(std::function<void()> task);
+
+        // Runs body(0) .. body(count - 1), in contiguous chunks per worker, and
+        // returns once all are done. The calling thread helps meanwhile, but
+        // only with this call's own tasks: a whole unrelated task (another
+        // stream's frame) never runs nested inside, delaying the return.
+        void ParallelFor(int count, const std::function<void(int)> &body);
+
+        uint64_t Executed();
+        uint64_t Stolen();      // Tasks run by another thread than the worker they were queued for
+};
+
+#endif
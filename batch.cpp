@@ -0,0 +1,90 @@
+#include "BatchProcessor.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Headless entry point: applies the same filters to every input file.
+// Example: DuckyVideoBatch -o out --greyscale --gaussian 5 a.mp4 b.mp4
+
+static void PrintUsage (const char *program) {
+    std::cout << "Usage: " << program << " -o <output dir> [options] <inputs...>\n"
+              << "Inputs are video files, folders of images or synthetic:WIDTHxHEIGHT:FRAMES\n"
+              << "Options:\n"
+              << "  --mirror-h              Mirror horizontally\n"
+              << "  --mirror-v              Mirror vertically\n"
+              << "  --rotate <deg>          Rotate clockwise by a multiple of 90 degrees\n"
+              << "  --zoom-out <n>          Halve the output size n times\n"
+              << "  --brightness <-255..255>\n"
+              << "  --contrast <factor>\n"
+              << "  --auto-exposure         Brightness and contrast from each frame's histogram\n"
+              << "  --greyscale\n"
+              << "  --negative\n"
+              << "  --edges                 Edge detection\n"
+              << "  --gradient\n"
+              << "  --gaussian <3..15>      Gaussian filter with odd kernel size\n"
+              << "  --denoise <1..32>       Average each frame with the ones before it\n"
+              << "  --threads <n>           Worker threads (default: one per core)" << std::endl;
+}
+
+int main (int argc, char** argv) {
+    FilterSpec spec;
+    std::string outputDir;
+    size_t threads = 0;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-o" && hasValue) {outputDir = argv[++i];}
+        else if (arg == "--mirror-h") {spec.mirrorH = true;}
+        else if (arg == "--mirror-v") {spec.mirrorV = true;}
+        else if (arg == "--rotate" && hasValue) {spec.rotation = std::atoi(argv[++i]);}
+        else if (arg == "--zoom-out" && hasValue) {spec.zoomOut = std::atoi(argv[++i]);}
+        else if (arg == "--brightness" && hasValue) {spec.brightness = std::atoi(argv[++i]);}
+        else if (arg == "--contrast" && hasValue) {spec.contrast = std::atof(argv[++i]);}
+        else if (arg == "--auto-exposure") {spec.autoExposure = true;}
+        else if (arg == "--greyscale") {spec.greyScale = true;}
+        else if (arg == "--negative") {spec.negative = true;}
+        else if (arg == "--edges") {spec.edgeDetection = true;}
+        else if (arg == "--gradient") {spec.gradient = true;}
+        else if (arg == "--gaussian" && hasValue) {spec.gaussianKernelSize = std::atoi(argv[++i]);}
+        else if (arg == "--denoise" && hasValue) {spec.denoiseFrames = std::atoi(argv[++i]);}
+        else if (arg == "--threads" && hasValue) {threads = std::atoi(argv[++i]);}
+        else if (arg.size() > 1 && arg[0] == '-') {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        else {inputs.push_back(arg);}
+    }
+
+    if (outputDir.empty() || inputs.empty()) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    if (spec.rotation % 90 != 0 || spec.zoomOut < 0 ||
+        spec.denoiseFrames < 0 || spec.denoiseFrames > TEMPORAL_MAX_WINDOW ||
+        (spec.gaussianKernelSize != 0 && (spec.gaussianKernelSize < 3 || spec.gaussianKernelSize % 2 == 0))) {
+        std::cout << "Invalid filter specification" << std::endl;
+        return 1;
+    }
+    std::filesystem::create_directories(outputDir);
+
+    auto start = std::chrono::steady_clock::now();
+    BatchProcessor processor(spec, outputDir, threads);
+    std::vector<BatchResult> results = processor.Run(inputs);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long long frames = 0;
+    int failed = 0;
+    for (const BatchResult &result : results) {
+        frames += result.frames;
+        if (!result.ok) {failed++;}
+    }
+    std::cout << "Total: " << frames << " frames from " << results.size() - failed << "/" << results.size()
+              << " files in " << seconds << " s (" << (seconds > 0 ? frames / seconds : 0) << " fps)" << std::endl;
+    return failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,587 @@
+#include "AllocationCounter.hpp"
+#include "AutoExposure.hpp"
+#include "FilterSpec.hpp"
+#include "FixedGaussian.hpp"
+#include "FramePool.hpp"
+#include "GeometryTransform.hpp"
+#include "GradientMagnitude.hpp"
+#include "MultiStreamPipeline.hpp"
+#include "PointLut.hpp"
+#include "TemporalFilter.hpp"
+#include "VideoManager.hpp"
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+using namespace cv;
+
+// Times every VideoManager filter on synthetic frames, on its own and in
+// common combinations, without needing a camera.
+// Example: DuckyVideoBench --json bench.json --csv bench.csv --only gaussian
+
+#define WARMUP_ITERATIONS 3
+#define MIN_ITERATIONS 5
+#define DEFAULT_MIN_TIME 0.5    // Seconds spent on each case
+#define MAX_BENCH_STREAMS 16
+
+struct Resolution {
+    std::string name;
+    int width, height;
+};
+
+// One benchmark case: edits the frame in place, like UpdateFrame does
+struct BenchCase {
+    std::string name;
+    std::function<void(Mat &frame)> run;
+    bool zeroAllocations = false;   // Expected to allocate nothing after warm-up
+    std::function<double()> hitRate = nullptr;  // Share of work reused, if the case reuses any
+    int framesPerRun = 1;           // Frames processed by one call of run
+};
+
+struct BenchResult {
+    std::string name,
+                resolution;
+    int width = 0,
+        height = 0;
+    long long iterations = 0;
+    double nsPerFrame = 0,
+           nsPerPixel = 0,
+           fps = 0,
+           allocsPerFrame = 0,
+           hitRate = -1;                // Not applicable
+    bool zeroAllocations = false;
+};
+
+
+// Deterministic frame with smooth areas, edges and some noise
+static Mat MakeSyntheticFrame (int width, int height) {
+    Mat frame(height, width, CV_8UC3);
+    RNG rng(12345);
+    rng.fill(frame, RNG::UNIFORM, Scalar::all(0), Scalar::all(256));
+    GaussianBlur(frame, frame, Size(0, 0), 4);
+    for (int i = 0; i < 40; i++) {
+        Point a(rng.uniform(0, width), rng.uniform(0, height)),
+              b(rng.uniform(0, width), rng.uniform(0, height));
+        Scalar color(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+        if (i % 2 == 0) {
+            rectangle(frame, a, b, color, FILLED);
+        } else {
+            circle(frame, a, rng.uniform(5, height/4 + 6), color, 3);
+        }
+    }
+    Mat noise(height, width, CV_8UC3);
+    rng.fill(noise, RNG::UNIFORM, Scalar::all(0), Scalar::all(16));
+    add(frame, noise, frame);
+    return frame;
+}
+
+// Frames the correctness checks run on: odd widths, so vector loops end in
+// a scalar tail, and both channel counts the pipeline produces
+static std::vector<Mat> MakeCheckFrames () {
+    std::vector<Mat> frames;
+    for (Size size : {Size(37, 23), Size(101, 64), Size(641, 479)}) {
+        Mat colour = MakeSyntheticFrame(size.width, size.height),
+            grey;
+        cvtColor(colour, grey, COLOR_BGR2GRAY);
+        frames.push_back(colour);
+        frames.push_back(grey);
+    }
+    return frames;
+}
+
+// PointLut against the chain it replaced: convertTo(contrast, brightness),
+// BGR2GRAY and back to BGR, then convertTo(-1, 255); greyscale output is
+// single-channel, so it is expanded before comparing
+static int CheckPointLut (const std::vector<Mat> &frames) {
+    int failed = 0;
+    PointLut lut;
+    Mat fast,
+        chain;
+    for (const Mat &frame : frames) {
+        for (int brightness : {-80, 0, 45}) {
+            for (float contrast : {0.5f, 1.0f, 1.7f}) {
+                for (int flags = 0; flags < 4; flags++) {
+                    bool negative = flags & 1,
+                         greyScale = flags & 2;
+                    lut.Build(contrast, brightness, negative, greyScale);
+                    lut.Apply(frame, fast);
+                    if (fast.channels() != frame.channels()) {cvtColor(fast, fast, COLOR_GRAY2BGR);}
+
+                    frame.convertTo(chain, -1, contrast, brightness);
+                    if (greyScale && chain.channels() == 3) {
+                        cvtColor(chain, chain, COLOR_BGR2GRAY);
+                        cvtColor(chain, chain, COLOR_GRAY2BGR);
+                    }
+                    if (negative) {chain.convertTo(chain, -1, -1, 255);}
+
+                    if (norm(fast, chain, NORM_INF) != 0) {
+                        std::cout << "PointLut differs from the conversion chain: brightness " << brightness
+                                  << ", contrast " << contrast << (negative ? ", negative" : "")
+                                  << (greyScale ? ", greyscale" : "") << ", "
+                                  << frame.cols << "x" << frame.rows << "x" << frame.channels() << std::endl;
+                        failed++;
+                    }
+                }
+            }
+        }
+    }
+    return failed;
+}
+
+// Shapes a FramePool stops being asked for (an old resolution, proxy or
+// quality level) must be let go, so memory follows the shapes in use
+static int CheckFramePool () {
+    FramePool pool;
+    for (int width = 16; width < 16 + 100; width++) {pool.Acquire(Size(width, 8), CV_8UC3);}
+    for (int i = 0; i < 2*FRAME_POOL_IDLE_ACQUIRES; i++) {pool.Acquire(Size(64, 8), CV_8UC3);}
+    if (pool.Count() != 1) {
+        std::cout << "FramePool keeps " << pool.Count() << " buffers of shapes no longer used" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Every gradient backend this CPU runs against the scalar one, and the
+// scalar one against the OpenCV chain: all must agree exactly
+static int CheckGradient (const std::vector<Mat> &frames) {
+    int failed = 0;
+    Mat scalar,
+        other;
+    for (const Mat &frame : frames) {
+        GradientMagnitude::Apply(frame, scalar, GradientBackend::Scalar);
+        for (GradientBackend backend : {GradientBackend::OpenCV, GradientBackend::SSE2, GradientBackend::AVX2}) {
+            if (!GradientMagnitude::IsSupported(backend)) continue;
+            GradientMagnitude::Apply(frame, other, backend);
+            if (norm(scalar, other, NORM_INF) != 0) {
+                std::cout << "Gradient " << GradientMagnitude::BackendName(backend) << " differs from scalar: "
+                          << frame.cols << "x" << frame.rows << "x" << frame.channels() << std::endl;
+                failed++;
+            }
+        }
+    }
+    return failed;
+}
+
+// FixedGaussian against GaussianBlur, for every size the slider offers
+static int CheckFixedGaussian (const std::vector<Mat> &frames) {
+    int failed = 0;
+    Mat fixed,
+        reference;
+    for (const Mat &frame : frames) {
+        for (int kernelSize = 3; kernelSize <= 15; kernelSize += 2) {
+            FixedGaussian::Apply(frame, fixed, kernelSize);
+            GaussianBlur(frame, reference, Size(kernelSize, kernelSize), 0, 0, BORDER_REFLECT_101);
+            double difference = norm(fixed, reference, NORM_INF);
+            if (difference > 1) {
+                std::cout << "FixedGaussian differs from GaussianBlur by " << difference << ": kernel " << kernelSize
+                          << ", " << frame.cols << "x" << frame.rows << "x" << frame.channels() << std::endl;
+                failed++;
+            }
+        }
+    }
+    return failed;
+}
+
+// A VideoManager running the whole UpdateFrame with the given settings
+static BenchCase ManagerCase (std::string name, FilterSpec spec, bool fullResolution = true,
+                              GradientBackend gradientBackend = GradientMagnitude::DefaultBackend(),
+                              std::shared_ptr<WorkStealingPool> stripPool = nullptr) {
+    std::shared_ptr<VideoManager> videoManager = std::make_shared<VideoManager>();
+    spec.ApplyTo(*videoManager);
+    videoManager->SetFullResolutionOutput(fullResolution);
+    videoManager->SetGradientBackend(gradientBackend);
+    // Frames are pooled, but OpenCV's Canny, GaussianBlur and Sobel still
+    // build their own kernels and scratch Mats on every call
+    bool zeroAllocations = !spec.edgeDetection
+                        && (spec.gaussianKernelSize == 0 || FixedGaussian::IsSupported(spec.gaussianKernelSize))
+                        && !(spec.gradient && gradientBackend == GradientBackend::OpenCV);
+    return {name, [videoManager, stripPool](Mat &frame) {
+        // Attached on the first (warm-up) run: strips limit OpenCV to one
+        // thread, which must not slow the cases before this one
+        videoManager->SetStripExecution(stripPool.get());
+        videoManager->SetFrame(frame);
+        videoManager->UpdateFrame();
+    }, zeroAllocations};
+}
+
+// Incremental mode on a static scene, or with a small object moving across it
+static BenchCase IncrementalCase (std::string name, FilterSpec spec, bool moving) {
+    std::shared_ptr<VideoManager> videoManager = std::make_shared<VideoManager>();
+    spec.ApplyTo(*videoManager);
+    videoManager->SetIncrementalMode(true);
+    std::shared_ptr<int> frameIndex = std::make_shared<int>(0);
+    BenchCase benchCase {name, [videoManager, moving, frameIndex](Mat &frame) {
+        if (moving) {
+            int x = (*frameIndex)++ * 16 % std::max(1, frame.cols - 64);
+            rectangle(frame, Rect(x, frame.rows/3, 64, 64), Scalar::all(255), FILLED);
+        }
+        videoManager->SetFrame(frame);
+        videoManager->UpdateFrame();
+    }};
+    benchCase.hitRate = [videoManager]() {return videoManager->GetIncrementalStats().hitRate;};
+    return benchCase;
+}
+
+// Unrecorded previews, filtered on a frame halved down to about width pixels
+static BenchCase ProxyCase (std::string name, FilterSpec spec, int width) {
+    std::shared_ptr<VideoManager> videoManager = std::make_shared<VideoManager>();
+    spec.ApplyTo(*videoManager);
+    videoManager->SetFullResolutionOutput(false);
+    videoManager->SetPreviewProxy(width);
+    return {name, [videoManager](Mat &frame) {
+        videoManager->SetFrame(frame);
+        videoManager->UpdateFrame();
+    }};
+}
+
+// The same frame through every stream of a shared-pool pipeline at once;
+// fps is then the aggregate over all streams
+static BenchCase MultiStreamCase (std::string name, FilterSpec spec, int streamCount,
+                                  std::shared_ptr<WorkStealingPool> pool) {
+    struct Streams {
+        std::shared_ptr<WorkStealingPool> pool;     // Outlives the pipeline
+        std::unique_ptr<MultiStreamPipeline> pipeline;
+    };
+    std::shared_ptr<Streams> streams = std::make_shared<Streams>();
+    streams->pool = pool;
+    streams->pipeline.reset(new MultiStreamPipeline(*pool));
+    StreamConfig config;
+    config.spec = spec;
+    for (int i = 0; i < streamCount; i++) {streams->pipeline->AddStream(config);}
+    BenchCase benchCase {name, [streams, streamCount](Mat &frame) {
+        streams->pipeline->Start();     // Only on the first run, like the strips of ManagerCase
+        for (int i = 0; i < streamCount; i++) {streams->pipeline->Submit(i, frame);}
+        streams->pipeline->WaitIdle();
+    }};
+    benchCase.framesPerRun = streamCount;
+    return benchCase;
+}
+
+static std::vector<BenchCase> BuildCases () {
+    std::vector<BenchCase> cases;
+
+    // Single operations, written the way UpdateFrame calls them
+    cases.push_back({"flip_h", [](Mat &frame) {flip(frame, frame, 1);}});
+    cases.push_back({"flip_v", [](Mat &frame) {flip(frame, frame, 0);}});
+    cases.push_back({"convertTo", [](Mat &frame) {frame.convertTo(frame, -1, 1.5, 20);}});
+    cases.push_back({"greyscale", [](Mat &frame) {
+        cvtColor(frame, frame, COLOR_BGR2GRAY);
+        cvtColor(frame, frame, COLOR_GRAY2BGR);
+    }});
+    cases.push_back({"negative", [](Mat &frame) {frame.convertTo(frame, -1, -1, 255);}});
+    for (int size = 3; size <= 15; size += 2) {
+        cases.push_back({"gaussian_" + std::to_string(size), [size](Mat &frame) {
+            GaussianBlur(frame, frame, Size(size, size), 0);
+        }});
+    }
+    // The compile-time specialized kernels, against GaussianBlur above
+    Mat gaussianOutput;
+    for (int size = 3; size <= 15; size += 2) {
+        cases.push_back({"gaussian_fixed_" + std::to_string(size), [gaussianOutput, size](Mat &frame) mutable {
+            FixedGaussian::Apply(frame, gaussianOutput, size);
+        }, true});
+    }
+    // Running-sum temporal filters: the window length should not change the cost
+    for (int window : {2, 8, 32}) {
+        std::shared_ptr<TemporalFilter> temporal = std::make_shared<TemporalFilter>();
+        Mat temporalOutput;
+        cases.push_back({"temporal_average_" + std::to_string(window), [temporal, temporalOutput, window](Mat &frame) mutable {
+            temporal->Apply(frame, temporalOutput, TemporalMode::Average, window, 0);
+        }, true});
+    }
+    std::shared_ptr<TemporalFilter> trail = std::make_shared<TemporalFilter>();
+    Mat trailOutput;
+    cases.push_back({"temporal_trail", [trail, trailOutput](Mat &frame) mutable {
+        trail->Apply(frame, trailOutput, TemporalMode::Trail, 1, 0.25f);
+    }, true});
+    // Auto exposure's histogram, on its sparse grid
+    cases.push_back({"exposure_histogram", [](Mat &frame) {
+        uint32_t histogram[256];
+        AutoExposure::Histogram(frame, EXPOSURE_GRID_STEP, histogram);
+    }, true});
+    cases.push_back({"canny", [](Mat &frame) {
+        cvtColor(frame, frame, COLOR_BGR2GRAY);
+        Canny(frame, frame, 50, 200);
+        cvtColor(frame, frame, COLOR_GRAY2BGR);
+    }});
+    cases.push_back({"sobel_gradient", [](Mat &frame) {
+        Mat gradX, gradY;
+        Sobel(frame, gradX, CV_16S, 1, 0, 3);
+        Sobel(frame, gradY, CV_16S, 0, 1, 3);
+        convertScaleAbs(gradX, gradX);
+        convertScaleAbs(gradY, gradY);
+        addWeighted(gradX, 0.5, gradY, 0.5, 0, frame);
+    }});
+    // The fused kernel on every backend this CPU has, against the chain above
+    Mat gradientOutput;
+    for (GradientBackend backend : {GradientBackend::Scalar, GradientBackend::SSE2, GradientBackend::AVX2}) {
+        if (!GradientMagnitude::IsSupported(backend)) continue;
+        cases.push_back({std::string("gradient_fused_") + GradientMagnitude::BackendName(backend), [gradientOutput, backend](Mat &frame) mutable {
+            GradientMagnitude::Apply(frame, gradientOutput, backend);
+        }, true});
+    }
+    cases.push_back({"zoom_out_2", [](Mat &frame) {
+        for (int i = 0; i < 2; i++) {resize(frame, frame, Size(), 0.5, 0.5);}
+    }});
+    cases.push_back({"rotate_90", [](Mat &frame) {rotate(frame, frame, ROTATE_90_CLOCKWISE);}});
+    Mat geometryOutput;
+    cases.push_back({"geometry_fused", [geometryOutput](Mat &frame) mutable {
+        GeometryTransform geometry;
+        geometry.mirrorH = true;
+        geometry.rotation = 90;
+        geometry.zoomLevels = 2;
+        geometry.Apply(frame, geometryOutput);
+    }});
+
+    // The whole UpdateFrame with common settings
+    FilterSpec spec;
+    cases.push_back(ManagerCase("manager_default", spec));
+
+    spec = FilterSpec();
+    spec.brightness = 20;
+    spec.contrast = 1.5;
+    cases.push_back(ManagerCase("manager_bright_contrast", spec));
+
+    spec = FilterSpec();
+    spec.autoExposure = true;
+    cases.push_back(ManagerCase("manager_auto_exposure", spec));
+
+    spec = FilterSpec();
+    spec.greyScale = true;
+    spec.negative = true;
+    cases.push_back(ManagerCase("manager_grey_negative", spec));
+
+    spec = FilterSpec();
+    spec.mirrorH = true;
+    spec.rotation = 90;
+    spec.zoomOut = 1;
+    cases.push_back(ManagerCase("manager_mirror_rotate_zoom", spec));
+
+    spec.gaussianKernelSize = 15;
+    spec.greyScale = true;
+    cases.push_back(ManagerCase("manager_zoom_gaussian15", spec));
+    cases.push_back(ManagerCase("manager_zoom_gaussian15_preview", spec, false));
+
+    spec = FilterSpec();
+    spec.gaussianKernelSize = 7;
+    spec.edgeDetection = true;
+    cases.push_back(ManagerCase("manager_gaussian7_edges", spec));
+
+    spec = FilterSpec();
+    spec.gradient = true;
+    cases.push_back(ManagerCase("manager_gradient", spec));
+    cases.push_back(ManagerCase("manager_gradient_opencv", spec, true, GradientBackend::OpenCV));
+
+    spec = FilterSpec();
+    spec.gaussianKernelSize = 15;
+    spec.edgeDetection = true;
+    spec.gradient = true;
+    cases.push_back(ManagerCase("manager_gaussian15_edges_gradient", spec));
+
+    // Strip execution from one core to all of them, against the sequential chain
+    spec = FilterSpec();
+    spec.mirrorH = true;
+    spec.brightness = 20;
+    spec.contrast = 1.5;
+    spec.gaussianKernelSize = 7;
+    spec.gradient = true;
+    cases.push_back(ManagerCase("manager_chain_sequential", spec));
+    int cores = std::max(1, (int)std::thread::hardware_concurrency());
+    for (int threads = 1; ; threads = std::min(threads*2, cores)) {
+        cases.push_back(ManagerCase("manager_chain_strips_t" + std::to_string(threads), spec, true,
+                                    GradientMagnitude::DefaultBackend(), std::make_shared<WorkStealingPool>(threads)));
+        if (threads == cores) break;
+    }
+
+    // Same chain, reusing the output of unchanged tiles
+    cases.push_back(IncrementalCase("manager_chain_incremental_static", spec, false));
+    cases.push_back(IncrementalCase("manager_chain_incremental_moving", spec, true));
+    FilterSpec denoised = spec;
+    denoised.denoiseFrames = 8;     // Tiles compared after the temporal filter
+    cases.push_back(IncrementalCase("manager_chain_incremental_denoise", denoised, false));
+
+    // Same chain on a preview that won't be recorded, filtered on a proxy
+    cases.push_back(ProxyCase("manager_chain_preview_proxy", spec, 640));
+
+    // Same chain on 1 to 16 streams sharing one pool (aggregate fps)
+    std::shared_ptr<WorkStealingPool> streamPool = std::make_shared<WorkStealingPool>();
+    for (int streamCount = 1; streamCount <= MAX_BENCH_STREAMS; streamCount *= 2) {
+        cases.push_back(MultiStreamCase("multi_stream_s" + std::to_string(streamCount), spec, streamCount, streamPool));
+    }
+
+    spec = FilterSpec();
+    spec.mirrorH = true;
+    spec.mirrorV = true;
+    spec.rotation = 270;
+    spec.zoomOut = 2;
+    spec.brightness = -30;
+    spec.contrast = 1.2;
+    spec.greyScale = true;
+    spec.negative = true;
+    spec.gaussianKernelSize = 5;
+    spec.edgeDetection = true;
+    spec.gradient = true;
+    cases.push_back(ManagerCase("manager_all", spec));
+
+    return cases;
+}
+
+static BenchResult RunCase (BenchCase &benchCase, const Resolution &resolution, const Mat &input, double minTime) {
+    Mat frame(input.size(), input.type());
+
+    for (int i = 0; i < WARMUP_ITERATIONS; i++) {
+        input.copyTo(frame);
+        benchCase.run(frame);
+    }
+
+    // Only the case itself is timed; restoring the input frame is not
+    long long iterations = 0,
+              allocations = 0;
+    double elapsed = 0;
+    while (iterations < MIN_ITERATIONS || elapsed < minTime) {
+        input.copyTo(frame);
+        long long allocationsBefore = AllocationCounter::Count();
+        auto start = std::chrono::steady_clock::now();
+        benchCase.run(frame);
+        elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        allocations += AllocationCounter::Count() - allocationsBefore;
+        iterations++;
+    }
+
+    BenchResult result;
+    result.name = benchCase.name;
+    result.resolution = resolution.name;
+    result.width = resolution.width;
+    result.height = resolution.height;
+    result.iterations = iterations;
+    result.nsPerFrame = elapsed * 1e9 / (iterations * benchCase.framesPerRun);
+    result.nsPerPixel = result.nsPerFrame / ((double)resolution.width * resolution.height);
+    result.fps = 1e9 / result.nsPerFrame;
+    result.allocsPerFrame = (double)allocations / (iterations * benchCase.framesPerRun);
+    result.zeroAllocations = benchCase.zeroAllocations;
+    if (benchCase.hitRate) {result.hitRate = benchCase.hitRate();}
+    return result;
+}
+
+static void WriteJson (const std::string &path, const std::vector<BenchResult> &results) {
+    std::ofstream out(path);
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        out << "  {\"case\": \"" << r.name << "\", \"resolution\": \"" << r.resolution
+            << "\", \"width\": " << r.width << ", \"height\": " << r.height
+            << ", \"iterations\": " << r.iterations << ", \"ns_per_frame\": " << r.nsPerFrame
+            << ", \"ns_per_pixel\": " << r.nsPerPixel << ", \"fps\": " << r.fps
+            << ", \"allocs_per_frame\": " << r.allocsPerFrame;
+        if (r.hitRate >= 0) {out << ", \"hit_rate\": " << r.hitRate;}
+        out << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+static void WriteCsv (const std::string &path, const std::vector<BenchResult> &results) {
+    std::ofstream out(path);
+    out << "case,resolution,width,height,iterations,ns_per_frame,ns_per_pixel,fps,allocs_per_frame,hit_rate\n";
+    for (const BenchResult &r : results) {
+        out << r.name << "," << r.resolution << "," << r.width << "," << r.height << ","
+            << r.iterations << "," << r.nsPerFrame << "," << r.nsPerPixel << ","
+            << r.fps << "," << r.allocsPerFrame << ",";
+        if (r.hitRate >= 0) {out << r.hitRate;}
+        out << "\n";
+    }
+}
+
+static void PrintUsage (const char *program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "Options:\n"
+              << "  --json <file>           Write results as JSON\n"
+              << "  --csv <file>            Write results as CSV\n"
+              << "  --only <text>           Run only cases whose name contains text\n"
+              << "  --resolution <name>     Run only 480p, 720p, 1080p or 4K\n"
+              << "  --min-time <seconds>    Time spent on each case (default 0.5)\n"
+              << "  --cv-threads <n>        Threads OpenCV may use itself (1 isolates strip scaling)\n"
+              << "  --assert-zero-alloc     Fail if a pooled VideoManager case allocates after warm-up" << std::endl;
+}
+
+int main (int argc, char** argv) {
+    std::string jsonPath,
+                csvPath,
+                only,
+                onlyResolution;
+    double minTime = DEFAULT_MIN_TIME;
+    bool assertZeroAlloc = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--json" && hasValue) {jsonPath = argv[++i];}
+        else if (arg == "--csv" && hasValue) {csvPath = argv[++i];}
+        else if (arg == "--only" && hasValue) {only = argv[++i];}
+        else if (arg == "--resolution" && hasValue) {onlyResolution = argv[++i];}
+        else if (arg == "--min-time" && hasValue) {minTime = std::atof(argv[++i]);}
+        else if (arg == "--cv-threads" && hasValue) {setNumThreads(std::atoi(argv[++i]));}
+        else if (arg == "--assert-zero-alloc") {assertZeroAlloc = true;}
+        else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Timing a kernel that gives the wrong answer is pointless
+    std::vector<Mat> checkFrames = MakeCheckFrames();
+    if (CheckFixedGaussian(checkFrames) + CheckGradient(checkFrames) + CheckPointLut(checkFrames)
+        + CheckFramePool() > 0) {return 4;}
+
+    AllocationCounter::Install();
+
+    std::vector<Resolution> resolutions = {
+        {"480p", 640, 480},
+        {"720p", 1280, 720},
+        {"1080p", 1920, 1080},
+        {"4K", 3840, 2160}
+    };
+
+    std::vector<BenchResult> results;
+    for (const Resolution &resolution : resolutions) {
+        if (!onlyResolution.empty() && resolution.name != onlyResolution) continue;
+        Mat input = MakeSyntheticFrame(resolution.width, resolution.height);
+
+        std::vector<BenchCase> cases = BuildCases();
+        for (BenchCase &benchCase : cases) {
+            if (!only.empty() && benchCase.name.find(only) == std::string::npos) continue;
+            BenchResult result = RunCase(benchCase, resolution, input, minTime);
+            benchCase = BenchCase();    // Its managers and pools go, and OpenCV gets its threads back
+            std::cout << resolution.name << "\t" << result.name << "\t"
+                      << result.nsPerPixel << " ns/px\t" << result.fps << " fps\t"
+                      << result.allocsPerFrame << " allocs/frame";
+            if (result.hitRate >= 0) {std::cout << "\t" << result.hitRate*100 << "% reused";}
+            std::cout << std::endl;
+            results.push_back(result);
+        }
+    }
+
+    if (!jsonPath.empty()) {WriteJson(jsonPath, results);}
+    if (!csvPath.empty()) {WriteCsv(csvPath, results);}
+
+    if (assertZeroAlloc) {
+        int failed = 0;
+        for (const BenchResult &r : results) {
+            if (r.zeroAllocations && r.allocsPerFrame > 0) {
+                std::cout << "Allocations after warm-up: " << r.resolution << " " << r.name << std::endl;
+                failed++;
+            }
+        }
+        if (failed > 0) {return 3;}
+    }
+    return 0;
+}
@@ -1,19 +1,38 @@
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QWidget>
 #include <QLabel>
 #include <QFrame>
 #include <QPushButton>
 #include <QSlider>
 #include "VideoManager.hpp"
-
+#include "VideoPipeline.hpp"
+#include "LatencyDashboard.hpp"
+#include "FrameSource.hpp"
+#include "FrameTracer.hpp"
+#include "PreviewWidget.hpp"
+#include "StageProfiler.hpp"
+#include "TemporalFilter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
 #include <opencv2/opencv.hpp>
 using namespace cv;
 
-#define CAMERA 0        // Open the default camera
-#define EXIT_KEY 27     // Stop capturing by pressing ESC
+#define SOURCE "0"      // Open the default camera
 #define FPS 30
+#define PRE_RECORD_MB 256
+#define PROXY_WIDTH 640     // About the width of the edited view in the preview
 
-#define COMMANDS_HEIGHT 585
+#define COMMANDS_HEIGHT 705
 #define COMMANDS_WIDTH 210
 #define BTN_HEIGHT 20
 #define BTN_WIDTH 200
@@ -22,6 +41,7 @@ using namespace cv;
 #define SLIDER_NUM_WIDTH 28
 #define SLIDER_TITLE_HEIGHT 15
 #define SPACE 5
+#define OCCUPANCY_REFRESH_MS 250
 
 #define BTN_ABOVE       BTN_HEIGHT+SPACE
 #define SLIDER_ABOVE    SLIDER_TITLE_HEIGHT+SLIDER_HEIGHT+SPACE*2
@@ -31,13 +51,77 @@ int main(int argc, char** argv)
 {
     // 0. BASIC CONFIGURATION FOR VIDEO CAPTURING
 
-    int camera = CAMERA;
-    VideoCapture cap;
-    if(!cap.open(camera)) // Check VideoCapture documentation;
-        return 0;
-    VideoWriter video;
+    // --source <spec> reads a camera index, a video file, a folder of images
+    // or a synthetic pattern instead of the default camera (see FrameSource);
+    // --raw records uncompressed frames (export them with DuckyVideoExport);
+    // --pre-record <s> starts recordings that many seconds before the button
+    // is pressed, keeping at most --pre-record-mb <MB> of frames in memory;
+    // --trace <file.json> saves a timeline of every frame's stages at exit
+    // (or when T is pressed in the preview);
+    // --proxy-width <px> sets how narrow unrecorded previews may be filtered
+    // (0: full resolution, and sliders only apply when released);
+    // --incremental [tolerance] reuses last frame's output wherever the camera
+    // image changed by at most tolerance per sample (0 if not given)
+    std::string sourceSpec = SOURCE,
+                tracePath;
+    bool rawRecording = false;
+    double preRecordSeconds = 0;
+    size_t preRecordMegabytes = PRE_RECORD_MB;
+    int proxyWidth = PROXY_WIDTH;
+    bool incremental = false;
+    double incrementalTolerance = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--source" && hasValue) {sourceSpec = argv[++i];}
+        else if (arg == "--raw") {rawRecording = true;}
+        else if (arg == "--pre-record" && hasValue) {preRecordSeconds = std::atof(argv[++i]);}
+        else if (arg == "--pre-record-mb" && hasValue) {
+            // Parsed whole, so "-1" or "abc" can't wrap into a huge buffer
+            char *end;
+            long long megabytes = std::strtoll(argv[++i], &end, 10);
+            if (*end != '\0' || megabytes <= 0 || (unsigned long long)megabytes > (SIZE_MAX >> 20)) {
+                std::cout << "--pre-record-mb takes a positive number of megabytes" << std::endl;
+                return 1;
+            }
+            preRecordMegabytes = (size_t)megabytes;
+        }
+        else if (arg == "--trace" && hasValue) {tracePath = argv[++i];}
+        else if (arg == "--proxy-width" && hasValue) {proxyWidth = std::max(0, std::atoi(argv[++i]));}
+        else if (arg == "--incremental") {
+            incremental = true;
+            // Only a number that follows is the tolerance
+            if (hasValue) {
+                char *end;
+                double tolerance = std::strtod(argv[i + 1], &end);
+                if (end != argv[i + 1] && *end == '\0' && tolerance >= 0) {
+                    incrementalTolerance = tolerance;
+                    i++;
+                }
+            }
+        }
+    }
+
+    std::unique_ptr<FrameSource> source = FrameSource::Open(sourceSpec);
+    if (!source) {
+        std::cout << "Failed to open " << sourceSpec << " (--source takes a camera index, "
+                  << "a video file, a folder of images or synthetic)" << std::endl;
+        return 1;
+    }
     VideoManager videoManager;
-    bool recording = false;
+    std::atomic<bool> recording {false};   // Shared with the pipeline threads
+    StageProfiler profiler;
+    std::unique_ptr<FrameTracer> tracer;   // Declared before every thread that records to it
+    if (!tracePath.empty()) {
+        tracer.reset(new FrameTracer(tracePath));
+        profiler.SetTracer(tracer.get());
+        FrameTracer::NameThread("gui");
+    }
+    videoManager.SetProfiler(&profiler);
+    WorkStealingPool stripPool;             // Filters run strip by strip on every core
+    videoManager.SetStripExecution(&stripPool);
+    videoManager.SetPreviewProxy(proxyWidth);  // Full resolution only for recorded frames
+    if (incremental) {videoManager.SetIncrementalMode(true, incrementalTolerance);}
 
 
     // 1. COMMAND WINDOW SECTION 1
@@ -128,6 +212,10 @@ int main(int argc, char** argv)
     QObject::connect(sliderBright, &QSlider::sliderReleased, [&videoManager, sliderBright]() {
         videoManager.AdjustBrightness(sliderBright->value());
     });
+    // Proxy previews are cheap enough to follow the slider while it is dragged
+    QObject::connect(sliderBright, &QSlider::valueChanged, [&videoManager, sliderBright, proxyWidth](int value) {
+        if (proxyWidth > 0 || !sliderBright->isSliderDown()) {videoManager.AdjustBrightness(value);}
+    });
     // Label to show slider value:
     QLabel *num1 = new QLabel(QString::number(sliderBright->value()), &window);
     num1->setGeometry(SLIDER_WIDTH+SPACE, currentHeight-2, SLIDER_NUM_WIDTH, SLIDER_HEIGHT);
@@ -162,6 +250,9 @@ int main(int argc, char** argv)
         float contrastValue = mapConstrastValue(sliderCont->value());
         videoManager.AdjustContrast(contrastValue);
     });
+    QObject::connect(sliderCont, &QSlider::valueChanged, [&videoManager, sliderCont, mapConstrastValue, proxyWidth](int value) {
+        if (proxyWidth > 0 || !sliderCont->isSliderDown()) {videoManager.AdjustContrast(mapConstrastValue(value));}
+    });
     // Label to show slider value:
     QLabel *num2 = new QLabel(QString::number(mapConstrastValue(sliderCont->value()), 'f', 2), &window);
     num2->setGeometry(SLIDER_WIDTH+SPACE, currentHeight-2, SLIDER_NUM_WIDTH, SLIDER_HEIGHT);
@@ -175,7 +266,19 @@ int main(int argc, char** argv)
     });
     currentHeight += SLIDER_HEIGHT;
 
-    // 2.3 Greyscale button
+    // 2.3 Auto exposure button (the sliders above do nothing while it is on)
+    QPushButton *btnExposure = new QPushButton("Auto exposure", &window);
+    btnExposure->setGeometry(SPACE, currentHeight, BTN_WIDTH, BTN_HEIGHT);
+    QObject::connect(btnExposure, &QPushButton::clicked, [&videoManager, btnExposure, sliderBright, sliderCont]() {
+        videoManager.AlterAutoExposure();
+        bool automatic = btnExposure->text() == "Auto exposure";
+        btnExposure->setText(automatic ? "Manual exposure" : "Auto exposure");
+        sliderBright->setEnabled(!automatic);
+        sliderCont->setEnabled(!automatic);
+    });
+    currentHeight += BTN_ABOVE;
+
+    // 2.4 Greyscale button
     QPushButton *btnGrey = new QPushButton("Greyscale", &window);
     btnGrey->setGeometry(SPACE, currentHeight, BTN_WIDTH, BTN_HEIGHT);
     QObject::connect(btnGrey, &QPushButton::clicked, [&videoManager, btnGrey]() {
@@ -184,7 +287,7 @@ int main(int argc, char** argv)
     });
     currentHeight += BTN_ABOVE;
 
-    // 2.4 Negative button
+    // 2.5 Negative button
     QPushButton *btnNegative = new QPushButton("Negative", &window);
     btnNegative->setGeometry(SPACE, currentHeight, BTN_WIDTH, BTN_HEIGHT);
     QObject::connect(btnNegative, &QPushButton::clicked, [&videoManager]() {
@@ -192,7 +295,7 @@ int main(int argc, char** argv)
     });
     currentHeight += BTN_ABOVE;
 
-    // 2.5 Edge detection button
+    // 2.6 Edge detection button
     QPushButton *btnEdges = new QPushButton("Edge detection", &window);
     btnEdges->setGeometry(SPACE, currentHeight, BTN_WIDTH, BTN_HEIGHT);
     QObject::connect(btnEdges, &QPushButton::clicked, [&videoManager, btnEdges]() {
@@ -201,7 +304,7 @@ int main(int argc, char** argv)
     });
     currentHeight += BTN_ABOVE;
 
-    // 2.6 Gradient button
+    // 2.7 Gradient button
     QPushButton *btnGrad = new QPushButton("Gradient", &window);
     btnGrad->setGeometry(SPACE, currentHeight, BTN_WIDTH, BTN_HEIGHT);
     QObject::connect(btnGrad, &QPushButton::clicked, [&videoManager, btnGrad]() {
@@ -209,9 +312,65 @@ int main(int argc, char** argv)
         btnGrad->setText(btnGrad->text() == "Gradient" ? "Turn off gradient" : "Gradient");
     });
     currentHeight += BTN_ABOVE;
+
+    // 2.8 Temporal filter button (cycles through off, denoise, trail and motion)
+    TemporalMode temporalMode = TemporalMode::Off;
+    QPushButton *btnTemporal = new QPushButton("Temporal: Off", &window);
+    btnTemporal->setGeometry(SPACE, currentHeight, BTN_WIDTH, BTN_HEIGHT);
+    QObject::connect(btnTemporal, &QPushButton::clicked, [&videoManager, &temporalMode, btnTemporal]() {
+        temporalMode = (TemporalMode)(((int)temporalMode + 1) % 4);
+        videoManager.SetTemporalMode(temporalMode);
+        btnTemporal->setText(QString("Temporal: %1").arg(TemporalFilter::ModeName(temporalMode)));
+    });
+    currentHeight += BTN_ABOVE;
+
+    // 2.9 Temporal window slider
+    // Description:
+    QLabel *title4 = new QLabel("Temporal window (frames):", &window);
+    title4->setGeometry(SPACE, currentHeight, BTN_WIDTH, SLIDER_TITLE_HEIGHT);
+    title4->setAlignment(Qt::AlignCenter);
+    currentHeight += SLIDER_TITLE_HEIGHT;
+    // Slider (a new window restarts the history, so it applies when released):
+    QSlider *sliderWindow = new QSlider(Qt::Horizontal, &window);
+    sliderWindow->setRange(1, TEMPORAL_MAX_WINDOW);
+    sliderWindow->setValue(8);
+    sliderWindow->setGeometry(SPACE, currentHeight, SLIDER_WIDTH, SLIDER_HEIGHT);
+    QObject::connect(sliderWindow, &QSlider::sliderReleased, [&videoManager, sliderWindow]() {
+        videoManager.AdjustTemporalWindow(sliderWindow->value());
+    });
+    // Label to show slider value (keyboard changes apply right away):
+    QLabel *num4 = new QLabel(QString::number(sliderWindow->value()), &window);
+    num4->setGeometry(SLIDER_WIDTH+SPACE, currentHeight-2, SLIDER_NUM_WIDTH, SLIDER_HEIGHT);
+    num4->setAlignment(Qt::AlignCenter);
+    QObject::connect(sliderWindow, &QSlider::valueChanged, [&videoManager, num4, sliderWindow](int value) {
+        num4->setText(QString::number(value));
+        if (!sliderWindow->isSliderDown()) {videoManager.AdjustTemporalWindow(value);}
+    });
+    currentHeight += SLIDER_HEIGHT;
+
+    // 2.10 Temporal blend slider
+    // Description:
+    QLabel *title5 = new QLabel("Trail / motion blend:", &window);
+    title5->setGeometry(SPACE, currentHeight, BTN_WIDTH, SLIDER_TITLE_HEIGHT);
+    title5->setAlignment(Qt::AlignCenter);
+    currentHeight += SLIDER_TITLE_HEIGHT;
+    // Slider (maps 1-100 to 0.01-1, applied while dragged):
+    QSlider *sliderBlend = new QSlider(Qt::Horizontal, &window);
+    sliderBlend->setRange(1, 100);
+    sliderBlend->setValue(25);
+    sliderBlend->setGeometry(SPACE, currentHeight, SLIDER_WIDTH, SLIDER_HEIGHT);
+    // Label to show slider value:
+    QLabel *num5 = new QLabel(QString::number(sliderBlend->value() / 100.0, 'f', 2), &window);
+    num5->setGeometry(SLIDER_WIDTH+SPACE, currentHeight-2, SLIDER_NUM_WIDTH, SLIDER_HEIGHT);
+    num5->setAlignment(Qt::AlignCenter);
+    QObject::connect(sliderBlend, &QSlider::valueChanged, [&videoManager, num5](int value) {
+        num5->setText(QString::number(value / 100.0, 'f', 2));
+        videoManager.AdjustTemporalBlend(value / 100.0f);
+    });
+    currentHeight += SLIDER_HEIGHT;
     currentHeight += SPACE;
 
-    // 2.7 Separation line
+    // 2.11 Separation line
     QFrame *line2 = new QFrame(&window);
     line2->setFrameShape(QFrame::HLine);
     line2->setFrameShadow(QFrame::Sunken); 
@@ -315,69 +474,118 @@ int main(int argc, char** argv)
     // 4.4 Reset button
     QPushButton *btnReset = new QPushButton("Reset", &window);
     btnReset->setGeometry(SPACE, currentHeight, BTN_WIDTH, BTN_HEIGHT);
-    QObject::connect(btnReset, &QPushButton::clicked, [&videoManager, btnZoomIn, btnDeGaussian, btnGrey, btnEdges, btnGrad]() {
+    QObject::connect(btnReset, &QPushButton::clicked, [&videoManager, &temporalMode, btnZoomIn, btnDeGaussian, btnGrey, btnEdges, btnGrad, btnTemporal, btnExposure, sliderBright, sliderCont]() {
         videoManager.Reset();
         btnZoomIn->setEnabled(false);
         btnDeGaussian->setEnabled(false);
         btnGrey->setText("Greyscale");
         btnEdges->setText("Edge detection");
         btnGrad->setText("Gradient");
+        temporalMode = TemporalMode::Off;
+        btnTemporal->setText("Temporal: Off");
+        btnExposure->setText("Auto exposure");
+        sliderBright->setEnabled(true);
+        sliderCont->setEnabled(true);
     });
 
 
-    // 5. LAUNCH WINDOW
+    // 5. LAUNCH WINDOWS
     window.show();
 
+    // 5.1 Latency charts, right next to the command window
+    LatencyDashboard dashboard(profiler, 1000.0/FPS);
+    dashboard.move(window.x() + window.frameGeometry().width() + SPACE, window.y());
+    dashboard.show();
+
+    // 5.2 Original and edited frames, below the command window (ESC closes)
+    PreviewWidget preview(&profiler);
+    preview.move(window.x(), window.y() + window.frameGeometry().height() + SPACE);
+    preview.show();
+
 
     // 6. LOOP FOR IMAGE CAPTURING
+    // Capture, editing and recording run on their own threads (see VideoPipeline);
+    // this loop only keeps the command window responsive and shows frames.
+
+    PipelineConfig config;
+    config.fps = FPS;
+    config.profiler = &profiler;
+    if (rawRecording) {
+        config.recorder.format = RecordFormat::Raw;
+        config.outputFile = "DuckyVideo.dkraw";
+    }
+    config.recorder.preRecordSeconds = preRecordSeconds;
+    config.recorder.preRecordBytes = preRecordMegabytes << 20;
+    config.quality.deadlineMs = 1000.0/FPS;    // Previews get cheaper when processing can't keep up
+    // Files, folders and patterns wait for processing instead of losing
+    // frames, and are recorded at their own rate
+    if (!source->IsLive()) {
+        config.processPolicy = QueuePolicy::Block;
+        if (source->Fps() > 0) {config.fps = (int)std::lround(source->Fps());}
+    }
+    VideoPipeline pipeline(*source, videoManager, recording, config);
+    pipeline.Start();
 
-    bool recordBuffer = false;
-    int frameWidth, frameHeight;
-    Mat frame, newFrame;
+    int status = 0;
+    FramePacket packet;
+    QElapsedTimer occupancyClock;
+    occupancyClock.start();
     for(;;) {
-        // Save last captured frame:
-        cap >> frame;   
-        if(frame.empty()) break;        // End video stream if nothing was captured
-        imshow("Original", frame);      // Show frame
-        videoManager.SetFrame(frame);   // Send frame to VideoManager
-
-        // Edit frame
-        QCoreApplication::processEvents();  // Allow command window events to be processed
-        videoManager.UpdateFrame();         // Update frame accordingly
-
-        // Record frame if required
-        newFrame = videoManager.GetCurrentFrame();
-        if (recording) {
-            // Configure new video
-            if (!recordBuffer) {
-                frameWidth = newFrame.cols;
-                frameHeight = newFrame.rows;
-                video.open("DuckyVideo.avi", VideoWriter::fourcc('M', 'J', 'P', 'G'), FPS, Size(frameWidth, frameHeight));
-                if (!video.isOpened()) {
-                    std::cout << "Failed to open video file" << std::endl;
-                    return -1;
-                }
-            }
-            // Register frame
-            video.write(newFrame); 
-        } else {
-            // Save recording in progress
-            if (recordBuffer) {
-                video.release();
-            }
-        }
+        QCoreApplication::processEvents();  // Command window events and preview repaints
 
-        // Save recording status for future iteration
-        recordBuffer = recording;
+        // Only the latest processed frame is worth showing
+        bool shown = false;
+        while (pipeline.PopDisplayFrame(packet)) {shown = true;}
+        if (shown) {preview.Present(packet);}
 
-        // Show new frame (with corrected dimensions)
-        newFrame = videoManager.GetRedimensionedFrame();
-        imshow("Edited", newFrame);     
+        if (pipeline.HasRecordingFailed()) {
+            status = -1;
+            break;
+        }
+        if (pipeline.IsFinished()) break;   // End video stream if nothing was captured
+
+        // How much history the next recording will start with
+        if (preRecordSeconds > 0 && !recording && occupancyClock.elapsed() >= OCCUPANCY_REFRESH_MS) {
+            RecorderStats recorderStats = pipeline.GetStats().recorder;
+            btnRec->setText(QString("Record (+%1 s, %2 MB)")
+                            .arg(recorderStats.bufferedSeconds, 0, 'f', 1).arg(recorderStats.bufferedBytes >> 20));
+            occupancyClock.restart();
+        }
+
+        // Stop capturing if the preview is closed or ESC is pressed
+        if (preview.IsExitRequested()) break;
+        if (!shown) {std::this_thread::sleep_for(std::chrono::milliseconds(1));}
+    }
 
-        // Stop capturing if exit key is pressed
-        if(waitKey(1) == EXIT_KEY) break; 
+    pipeline.Stop();
+    PipelineStats stats = pipeline.GetStats();
+    std::cout << "Frames captured: " << stats.captured
+              << ", processed: " << stats.processed
+              << ", recorded: " << stats.recorder.written << std::endl;
+    std::cout << "Dropped frames (process/record/display): " << stats.process.dropped
+              << "/" << stats.recorder.dropped << "/" << stats.display.dropped << std::endl;
+    std::cout << "Recording: " << stats.recorder.encodeMs << " ms per JPEG, "
+              << stats.recorder.bytesPerSecond / 1e6 << " MB/s" << std::endl;
+    std::cout << "Preview: " << preview.Painted() << " of " << preview.Presented()
+              << " frames painted" << std::endl;
+    std::cout << "Preview quality: " << QualityScheduler::LevelName(stats.quality.level)
+              << " (" << stats.quality.changes << " changes, "
+              << stats.quality.skipped << " frames skipped)" << std::endl;
+    ExposureStats exposure = videoManager.GetExposureStats();
+    if (exposure.frames > 0) {
+        std::cout << "Auto exposure: levels " << exposure.low << "-" << exposure.high
+                  << ", brightness " << exposure.brightness << ", contrast " << exposure.contrast
+                  << " (" << exposure.samples << " samples per frame, "
+                  << profiler.Summary(Stage::Exposure).p50 << " ms p50)" << std::endl;
+    }
+    if (incremental) {
+        IncrementalStats reuse = videoManager.GetIncrementalStats();
+        std::cout << "Incremental: " << reuse.hitRate * 100 << "% of tiles reused over "
+                  << reuse.frames << " frames (" << reuse.uncoveredFrames << " frames uncovered)" << std::endl;
+    }
+    if (tracer) {
+        std::cout << (tracer->Write() ? "Trace saved to " : "Failed to save trace to ") << tracePath << std::endl;
     }
 
-    cap.release(); // Release the VideoCapture object
-    return 0;
+    return status;
 }
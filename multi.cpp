@@ -0,0 +1,163 @@
+#include "FrameTracer.hpp"
+#include "MultiStreamPipeline.hpp"
+#include "WorkStealingPool.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Headless multi-stream mode: every source with its own filters and output,
+// all processed on one shared pool.
+// Example: DuckyVideoMulti --source 0 --greyscale -o cam0.avi --source 1 --gaussian 5 --source a.mp4 --edges
+
+#define REPORT_SECONDS 5
+
+static void PrintUsage (const char *program) {
+    std::cout << "Usage: " << program << " --source <source> [stream options] [--source ...] [options]\n"
+              << "A source is a camera index, a video file, a folder of images or synthetic[:WIDTHxHEIGHT[:FRAMES]]\n"
+              << "Stream options (apply to the source before them):\n"
+              << "  -o <file>               Record the stream (.avi, or .dkraw for raw frames)\n"
+              << "  --weight <w>            Share of the pool when streams compete (default 1)\n"
+              << "  --mirror-h, --mirror-v, --rotate <deg>, --zoom-out <n>, --brightness <v>,\n"
+              << "  --contrast <f>, --greyscale, --negative, --edges, --gradient, --gaussian <k>,\n"
+              << "  --denoise <frames>, --auto-exposure\n"
+              << "  --incremental [tol]     Reuse last frame's output where the image did not change,\n"
+              << "                          with up to tol average difference per sample (default 0)\n"
+              << "Options:\n"
+              << "  --threads <n>           Pool threads (default: one per core)\n"
+              << "  --seconds <s>           Stop after that long (default: when every source ends)\n"
+              << "  --trace <file.json>     Save a per-frame timeline of every stage (Chrome trace format)" << std::endl;
+}
+
+// The tolerance after --incremental is optional, so only a whole
+// non-negative number is taken as one
+static bool ParseTolerance (const char *text, double &tolerance) {
+    char *end;
+    double value = std::strtod(text, &end);
+    if (end == text || *end != '\0' || !(value >= 0)) {return false;}
+    tolerance = value;
+    return true;
+}
+
+static void PrintStats (const std::vector<StreamStats> &all) {
+    double total = 0;
+    for (const StreamStats &stats : all) {
+        std::cout << std::setw(24) << stats.source << "  " << std::fixed << std::setprecision(1)
+                  << stats.fps << " fps, latency p50/p95 " << stats.latencyP50 << "/" << stats.latencyP95
+                  << " ms, process p50 " << stats.processP50 << " ms, dropped " << stats.dropped
+                  << ", recorded " << stats.recorded;
+        const IncrementalStats &incremental = stats.incremental;
+        if (incremental.frames + incremental.uncoveredFrames > 0) {
+            std::cout << ", tiles reused " << incremental.hitRate * 100 << "%"
+                      << " (" << incremental.uncoveredFrames << " frames uncovered)";
+        }
+        std::cout << std::endl;
+        total += stats.fps;
+    }
+    std::cout << "Aggregate: " << total << " fps over " << all.size() << " streams" << std::endl;
+}
+
+int main (int argc, char** argv) {
+    std::vector<StreamConfig> configs;
+    size_t threads = 0;
+    double seconds = 0;
+    std::string tracePath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--source" && hasValue) {
+            configs.emplace_back();
+            configs.back().source = argv[++i];
+            continue;
+        }
+        if (arg == "--threads" && hasValue) {threads = std::atoi(argv[++i]); continue;}
+        if (arg == "--seconds" && hasValue) {seconds = std::atof(argv[++i]); continue;}
+        if (arg == "--trace" && hasValue) {tracePath = argv[++i]; continue;}
+        if (configs.empty()) {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        StreamConfig &config = configs.back();
+        FilterSpec &spec = config.spec;
+        if (arg == "-o" && hasValue) {
+            config.outputFile = argv[++i];
+            if (config.outputFile.size() > 6 && config.outputFile.substr(config.outputFile.size() - 6) == ".dkraw") {
+                config.recorder.format = RecordFormat::Raw;
+            }
+        }
+        else if (arg == "--weight" && hasValue) {config.weight = std::atof(argv[++i]);}
+        else if (arg == "--incremental") {
+            config.incremental = true;
+            if (hasValue && ParseTolerance(argv[i + 1], config.incrementalTolerance)) {i++;}
+        }
+        else if (arg == "--mirror-h") {spec.mirrorH = true;}
+        else if (arg == "--mirror-v") {spec.mirrorV = true;}
+        else if (arg == "--rotate" && hasValue) {spec.rotation = std::atoi(argv[++i]);}
+        else if (arg == "--zoom-out" && hasValue) {spec.zoomOut = std::atoi(argv[++i]);}
+        else if (arg == "--brightness" && hasValue) {spec.brightness = std::atoi(argv[++i]);}
+        else if (arg == "--contrast" && hasValue) {spec.contrast = std::atof(argv[++i]);}
+        else if (arg == "--auto-exposure") {spec.autoExposure = true;}
+        else if (arg == "--greyscale") {spec.greyScale = true;}
+        else if (arg == "--negative") {spec.negative = true;}
+        else if (arg == "--edges") {spec.edgeDetection = true;}
+        else if (arg == "--gradient") {spec.gradient = true;}
+        else if (arg == "--gaussian" && hasValue) {spec.gaussianKernelSize = std::atoi(argv[++i]);}
+        else if (arg == "--denoise" && hasValue) {spec.denoiseFrames = std::atoi(argv[++i]);}
+        else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (configs.empty()) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    for (const StreamConfig &config : configs) {
+        const FilterSpec &spec = config.spec;
+        if (config.weight <= 0 || spec.rotation % 90 != 0 || spec.zoomOut < 0 ||
+            spec.denoiseFrames < 0 || spec.denoiseFrames > TEMPORAL_MAX_WINDOW ||
+            (spec.gaussianKernelSize != 0 && (spec.gaussianKernelSize < 3 || spec.gaussianKernelSize % 2 == 0))) {
+            std::cout << "Invalid settings for " << config.source << std::endl;
+            return 1;
+        }
+    }
+
+    // Outlives the pool and pipeline threads recording to it
+    std::unique_ptr<FrameTracer> tracer;
+    if (!tracePath.empty()) {tracer.reset(new FrameTracer(tracePath));}
+    WorkStealingPool pool(threads);
+    MultiStreamPipeline pipeline(pool);
+    for (const StreamConfig &config : configs) {
+        if (pipeline.AddStream(config) < 0) {
+            std::cout << "Failed to open " << config.source << std::endl;
+            return 2;
+        }
+    }
+    pipeline.SetTracer(tracer.get());
+
+    pipeline.Start();
+    auto start = std::chrono::steady_clock::now(),
+         lastReport = start;
+    while (!pipeline.IsFinished()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto now = std::chrono::steady_clock::now();
+        if (seconds > 0 && std::chrono::duration<double>(now - start).count() >= seconds) break;
+        if (std::chrono::duration<double>(now - lastReport).count() >= REPORT_SECONDS) {
+            PrintStats(pipeline.GetStats());
+            lastReport = now;
+        }
+    }
+    pipeline.Stop();
+    PrintStats(pipeline.GetStats());
+    if (tracer && !tracer->Write()) {
+        std::cout << "Failed to save trace to " << tracePath << std::endl;
+        return 3;
+    }
+    return 0;
+}